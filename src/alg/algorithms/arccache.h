@@ -10,7 +10,6 @@
 
 template <typename Key, typename Value>
 class ARCCache {
-    typedef std::unordered_map<std::string, size_t> ContentSizes;
 public:
     ARCCache() {};
     explicit ARCCache(size_t size, const size_t & learn_limit = 100, const size_t & period = 1000) :
@@ -63,7 +62,7 @@ public:
                 bottom1Lru.erase(bottom1Lru.lruItem()->first);
                 replace(key);
             } else {
-                evicted(top1Lru.lruItem()->first, top1Lru.lruItem()->first);
+                evicted(top1Lru.lruItem()->first, top1Lru.lruItem()->second);
                 top1Lru.erase(top1Lru.lruItem()->first);
             }
         } else if (l1Size < cacheSize && (l1Size + l2Size >= cacheSize)) {
@@ -89,30 +88,28 @@ public:
     }
 
     size_t elementsCount() const {
-        return 0;
+        return top1Lru.elementsCount() + top2Lru.elementsCount();
     }
 
-    ContentSizes getContentSizes() {
-        return contentSizes;
+    const ContentSizes & getContentSizes() const {
+        return *contentSizes;
     }
 
     size_t getCacheSize() {
-        return currentCacheSize;
+        return top1Lru.getCacheSize() + top2Lru.getCacheSize();
     }
 
-    void addCidSize(std::string cid, size_t size) {
-        ContentSizes::iterator it = contentSizes.find(cid);
-        if (it != contentSizes.end() && it->second != size) {
-            std::cout << "Another size for content. Was -> " <<  it->second
-                << " now -> "<< size 
-                << " for cid -> " << cid << std::endl;
-        }
+    void setContentSizes(const ContentSizes *sizes) {
+        contentSizes = sizes;
 
-        contentSizes[cid] = size;
+        top1Lru.setContentSizes(sizes);
+        top2Lru.setContentSizes(sizes);
+        bottom1Lru.setContentSizes(sizes);
+        bottom2Lru.setContentSizes(sizes);
     }
 
-    VecStr get_hot_content(const float &cache_hot_content) {
-        return VecStr();
+    std::vector<Key> get_hot_content(const float &cache_hot_content) {
+        return std::vector<Key>();
     }
 
 private:
@@ -143,7 +140,6 @@ private:
 
 private:
     size_t cacheSize;
-    size_t currentCacheSize;
     size_t splitPoint;
 
     LRUCache<Key, Value> top1Lru;
@@ -154,5 +150,5 @@ private:
 
     std::function<void(const Key &,const Value &)> evictionCallback;
 
-    ContentSizes contentSizes;
+    const ContentSizes *contentSizes = nullptr;
 };
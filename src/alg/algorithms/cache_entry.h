@@ -0,0 +1,31 @@
+#pragma once
+
+
+/* value type of policies which only keep track of cached keys */
+struct NoValue {};
+
+
+/* item of policy lists, a key with its value */
+template <typename Key, typename Value>
+struct CacheEntry {
+    CacheEntry(const Key &key, const Value &value) :
+        first(key),
+        second(value) {}
+
+    Key first;
+    Value second;
+};
+
+
+/* set-only mode, the item stores the key and all items share the empty value */
+template <typename Key>
+struct CacheEntry<Key, NoValue> {
+    CacheEntry(const Key &key, const NoValue &) :
+        first(key) {}
+
+    Key first;
+    static NoValue second;
+};
+
+template <typename Key>
+NoValue CacheEntry<Key, NoValue>::second;
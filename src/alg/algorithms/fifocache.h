@@ -1,16 +1,17 @@
 #pragma once
 
 #include "defs.h"
+#include "flat_hash_map.h"
+#include "node_pool.h"
+#include "cache_entry.h"
 
 #include <cstdlib>
 #include <cassert>
 #include <functional>
 #include <list>
-#include <unordered_map>
 
 template <typename Key, typename Value>
 class FifoCache {
-    typedef std::unordered_map<std::string, size_t> ContentSizes;
 public:
     FifoCache() {};
     explicit FifoCache(size_t size, const size_t & learn_limit = 100, const size_t & period = 1000) :
@@ -37,14 +38,14 @@ public:
             return result;
         }
 
-        size_t cidSize = contentSizes[key];
+        size_t cidSize = get_content_size(*contentSizes, key);
 
         if (cidSize > cacheSize)
             return nullptr;
 
         makeSizeInvariant(cacheSize - cidSize);
 
-        fifo.push_back(std::make_pair(key, value));
+        fifo.push_back(CacheEntry<Key, Value>(key, value));
 
         auto addedItemIt = --fifo.end();
         lookup[key] = addedItemIt;
@@ -62,7 +63,7 @@ public:
             return false;
         }
 
-        size_t cidSize = contentSizes[key];
+        size_t cidSize = get_content_size(*contentSizes, key);
         currentCacheSize -= cidSize;
         
         fifo.erase(it->second);
@@ -88,27 +89,20 @@ public:
         evictionCallback = callback;
     }
 
-    ContentSizes getContentSizes() {
-        return contentSizes;
+    const ContentSizes & getContentSizes() const {
+        return *contentSizes;
     }
 
     size_t getCacheSize() {
         return currentCacheSize;
     }
 
-    void addCidSize(std::string cid, size_t size) {
-        ContentSizes::iterator it = contentSizes.find(cid);
-        if (it != contentSizes.end() && it->second != size) {
-            std::cout << "Another size for content. Was -> " <<  it->second
-                << " now -> "<< size 
-                << " for cid -> " << cid << std::endl;
-        }
-
-        contentSizes[cid] = size;
+    void setContentSizes(const ContentSizes *sizes) {
+        contentSizes = sizes;
     }
 
-    VecStr get_hot_content(const float &cache_hot_content) {
-        return VecStr();
+    std::vector<Key> get_hot_content(const float &cache_hot_content) {
+        return std::vector<Key>();
     }
 
 private:
@@ -119,7 +113,7 @@ private:
             }
 
             auto cid = fifo.front().first;
-            auto cidSize = contentSizes[cid];
+            auto cidSize = get_content_size(*contentSizes, cid);
             lookup.erase(cid);
             fifo.pop_front();
             currentCacheSize -= cidSize;
@@ -127,11 +121,11 @@ private:
     }
 
 private:
-    typedef std::list<std::pair<Key, Value>> Fifo;
+    typedef std::list<CacheEntry<Key, Value>, PoolAllocator<CacheEntry<Key, Value>>> Fifo;
     Fifo fifo;
-    std::unordered_map<Key, typename Fifo::iterator> lookup;
+    FlatHashMap<Key, typename Fifo::iterator> lookup;
     size_t cacheSize;
     size_t currentCacheSize;
     std::function<void(const Key &,const Value &)> evictionCallback;
-    ContentSizes contentSizes;
+    const ContentSizes *contentSizes = nullptr;
 };
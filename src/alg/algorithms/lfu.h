@@ -1,6 +1,9 @@
 #pragma once
 
 #include "defs.h"
+#include "flat_hash_map.h"
+#include "node_pool.h"
+#include "cache_entry.h"
 
 #include <list>
 #include <utility>
@@ -8,14 +11,27 @@
 #include <cassert>
 #include <iostream>
 #include <functional>
-#include <unordered_map>
 
 
+/*
+    LFU keeps a list of frequency buckets in increasing order of frequency,
+    only buckets with items are kept. Items of a bucket are in the order
+    they reached its frequency, the oldest one is evicted first.
+    A hit splices the item into the bucket of the next frequency.
+*/
 template <typename Key, typename Value>
 class LFUCache {
-    typedef std::list<std::pair<Key, Value>> ItemList;
-    typedef std::list<ItemList> LFUList;
-    typedef std::unordered_map<std::string, size_t> ContentSizes;
+    typedef std::list<CacheEntry<Key, Value>, PoolAllocator<CacheEntry<Key, Value>>> ItemList;
+
+    struct FrequencyBucket {
+        FrequencyBucket(const size_t &frequency, const PoolAllocator<CacheEntry<Key, Value>> &allocator) :
+            frequency(frequency),
+            items(allocator) {}
+
+        size_t frequency;
+        ItemList items;
+    };
+    typedef std::list<FrequencyBucket, PoolAllocator<FrequencyBucket>> LFUList;
 
     struct ItemMeta {
         ItemMeta() {}
@@ -54,18 +70,20 @@ public:
             return result;
         }
 
-        if (lfuList.empty()) {
-            lfuList.push_back(ItemList());
-        }
-
-        size_t cidSize = contentSizes[key];
+        size_t cidSize = get_content_size(*contentSizes, key);
         if (cidSize > cacheSize)
             return nullptr;
 
         makeSizeInvariant(cacheSize - cidSize);
 
-        lfuList.front().push_back(std::make_pair(key, value));
-        auto addedItemIt = --lfuList.front().end();
+        // new items have frequency 1
+        if (lfuList.empty() || lfuList.front().frequency != 1) {
+            lfuList.emplace_front(1, lfuList.get_allocator());
+        }
+
+        ItemList &items = lfuList.front().items;
+        items.push_back(CacheEntry<Key, Value>(key, value));
+        auto addedItemIt = --items.end();
         lookup[key] = ItemMeta(addedItemIt, lfuList.begin());
 
         currentCacheSize += cidSize;
@@ -80,9 +98,10 @@ public:
             return false;
         }
 
-        ItemMeta &itemMeta = it->second;
-        itemMeta.lfuIt->erase(itemMeta.itemIt);
+        ItemMeta itemMeta = it->second;
         lookup.erase(it);
+        currentCacheSize -= get_content_size(*contentSizes, key);
+        removeItem(itemMeta);
 
         return true;
     }
@@ -104,91 +123,79 @@ public:
         evictionCallback = callback;
     }
 
-    ContentSizes getContentSizes() {
-        return contentSizes;
+    const ContentSizes & getContentSizes() const {
+        return *contentSizes;
     }
 
     size_t getCacheSize() {
         return currentCacheSize;
     }
 
-    void addCidSize(std::string cid, size_t size) {
-        ContentSizes::iterator it = contentSizes.find(cid);
-        if (it != contentSizes.end() && it->second != size) {
-            std::cout << "Size is repeated. Was -> " <<  it->second
-                << " now -> "<< size 
-                << " for cid -> " << cid << std::endl;
-
-        }
-        
-        contentSizes[cid] = size;
+    void setContentSizes(const ContentSizes *sizes) {
+        contentSizes = sizes;
     }
 
-    VecStr get_hot_content(const float &cache_hot_content) {
-        return VecStr();
+    std::vector<Key> get_hot_content(const float &cache_hot_content) {
+        return std::vector<Key>();
     }
 
 private:
     void makeSizeInvariant(size_t size) {
         while (getCacheSize() > size) {
-            auto lfuIt = lfuList.begin();
-            while (lfuIt->empty() && lfuIt != lfuList.end()) {
-                ++lfuIt;
-            }
+            assert(!lfuList.empty());
 
-            assert(lfuIt != lfuList.end());
+            auto lfuIt = lfuList.begin();
+            auto itemIt = lfuIt->items.begin();
+            const Key key = itemIt->first;
 
             if (evictionCallback) {
-                evictionCallback(lfuIt->front().first, lfuIt->front().second);
+                evictionCallback(key, itemIt->second);
             }
 
-            assert(!lfuIt->empty());
-
-            const Key &key = lfuIt->front().first;
-
-            currentCacheSize -= contentSizes[key];
+            currentCacheSize -= get_content_size(*contentSizes, key);
 
             lookup.erase(key);
 
-            lfuIt->pop_front();
+            removeItem(ItemMeta(itemIt, lfuIt));
         }
     }
 
-    typename ItemList::iterator promote(ItemMeta itemMeta) {
-        Key key = itemMeta.itemIt->first;
+    // remove the item and its bucket if it becomes empty
+    void removeItem(const ItemMeta &itemMeta) {
+        itemMeta.lfuIt->items.erase(itemMeta.itemIt);
+        if (itemMeta.lfuIt->items.empty()) {
+            lfuList.erase(itemMeta.lfuIt);
+        }
+    }
 
-        auto nextLfuIt = itemMeta.lfuIt;
+    typename ItemList::iterator promote(ItemMeta &itemMeta) {
+        auto lfuIt = itemMeta.lfuIt;
+        auto nextLfuIt = lfuIt;
         ++nextLfuIt;
 
-        if (nextLfuIt == lfuList.end()) {
-            lfuList.push_back(ItemList());
-            nextLfuIt = --lfuList.end();
+        size_t frequency = lfuIt->frequency + 1;
+        if (nextLfuIt == lfuList.end() || nextLfuIt->frequency != frequency) {
+            nextLfuIt = lfuList.emplace(nextLfuIt, frequency, lfuList.get_allocator());
         }
 
-        assert(itemMeta.lfuIt != nextLfuIt);
-
-        nextLfuIt->push_back(*itemMeta.itemIt);
+        // buckets share the allocator, so splice moves the node
+        nextLfuIt->items.splice(nextLfuIt->items.end(), lfuIt->items, itemMeta.itemIt);
+        itemMeta.lfuIt = nextLfuIt;
 
-        auto itemIt = --nextLfuIt->end();
-
-        lookup[key] = ItemMeta(itemIt, nextLfuIt);
-
-        assert(itemIt != itemMeta.itemIt);
-
-        assert(key == itemMeta.itemIt->first);
-
-        itemMeta.lfuIt->erase(itemMeta.itemIt);
+        if (lfuIt->items.empty()) {
+            lfuList.erase(lfuIt);
+        }
 
-        return itemIt;
+        return itemMeta.itemIt;
     }
 
 private:
-    std::unordered_map<Key, ItemMeta> lookup;
+    FlatHashMap<Key, ItemMeta> lookup;
     LFUList lfuList;
     size_t cacheSize;
     size_t currentCacheSize;
 
     std::function<void(const Key &,const Value &)> evictionCallback;
 
-    ContentSizes contentSizes;
+    const ContentSizes *contentSizes = nullptr;
 };
@@ -1,9 +1,11 @@
 #pragma once
 
 #include "defs.h"
+#include "flat_hash_map.h"
+#include "cache_entry.h"
 
-#include <list>
-#include <unordered_map>
+#include <vector>
+#include <cstdint>
 #include <cstdlib>
 #include <iostream>
 #include <functional>
@@ -12,10 +14,25 @@
 #define MAX(X, Y) ((X) > (Y) ? (X) : (Y))
 
 
+/*
+    LRU list is kept in a node array linked by 32-bit indices,
+    freed nodes are reused, so a hit only relinks the node.
+*/
 template <typename Key, typename Value>
 class LRUCache {
-    typedef std::list<std::pair<Key, Value>> LruList;
-    typedef std::unordered_map<std::string, size_t> ContentSizes;
+    typedef uint32_t NodeIndex;
+    static const NodeIndex NIL = UINT32_MAX;
+
+    struct Node {
+        Node(const Key &key, const Value &value) :
+            item(key, value),
+            prev(NIL),
+            next(NIL) {}
+
+        CacheEntry<Key, Value> item;
+        NodeIndex prev;
+        NodeIndex next;
+    };
 public:
     LRUCache() {};
     explicit LRUCache(size_t size, const size_t & learn_limit = 100, const size_t & period = 1000) :
@@ -23,19 +40,14 @@ public:
             currentCacheSize(0) {}
 
     Value* find(const Key &key, const size_t & current_time = 0) {
-        // std::cout << "lru find 1.1" << std::endl;
-        // std::cout << "lookup.size() -> " << lookup.size() << std::endl;
         auto it = lookup.find(key);
 
-        // std::cout << "lru find 1.2" << std::endl;
-
         if (it == lookup.end()) {
             return nullptr;
         }
 
-        // std::cout << "lru find 2" << std::endl;
-
-        return &promote(it->second)->second;
+        promote(it->second);
+        return &nodes[it->second].item.second;
     }
 
     void prepare_cache() {
@@ -43,35 +55,27 @@ public:
     }
 
     Value* put(const Key &key, const Value &value, const size_t & current_time = 0) {
-        // std::cout << "lru put 1.1" << std::endl;
-
         Value *result = find(key);
         if (result) {
             return result;
         }
 
-        // std::cout << "lru put 1.2" << std::endl;
-
-        if (contentSizes.find(key) == contentSizes.end()) {
+        if (!contentSizes->contains(key)) {
             std::cout << "there is not cid: " << key << " in contentSizes" << std::endl;
         }
-        size_t cidSize = contentSizes[key];
+        size_t cidSize = get_content_size(*contentSizes, key);
         if (cidSize > cacheSize)
             return nullptr;
 
-        // std::cout << "lru put 2" << std::endl;
-
         makeSizeInvariant(cacheSize - cidSize);
 
-        lruList.push_back(std::make_pair(key, value));
-        auto addedIt = --lruList.end();
-        lookup[key] = addedIt;
+        NodeIndex index = allocate(key, value);
+        linkBack(index);
+        lookup[key] = index;
 
         currentCacheSize += cidSize;
 
-        // std::cout << "lru put 3" << std::endl;
-
-        return &addedIt->second;
+        return &nodes[index].item.second;
     }
 
     bool erase(const Key &key) {
@@ -81,11 +85,13 @@ public:
             return false;
         }
 
-        size_t cidSize = contentSizes[key];
+        size_t cidSize = get_content_size(*contentSizes, key);
         currentCacheSize -= cidSize;
 
-        lruList.erase(it->second);
+        NodeIndex index = it->second;
         lookup.erase(it);
+        unlink(index);
+        release(index);
 
         return true;
     }
@@ -110,85 +116,119 @@ public:
         makeSizeInvariant(cacheSize);
     }
 
-    const std::pair<Key, Value> *mruItem() const {
-        return &lruList.back();
+    const CacheEntry<Key, Value> *mruItem() const {
+        return (tail != NIL) ? &nodes[tail].item : nullptr;
     }
 
-    const std::pair<Key, Value> *lruItem() const {
-        return &lruList.front();
+    const CacheEntry<Key, Value> *lruItem() const {
+        return (head != NIL) ? &nodes[head].item : nullptr;
     }
 
-    ContentSizes getContentSizes() {
-        return contentSizes;
+    const ContentSizes & getContentSizes() const {
+        return *contentSizes;
     }
 
     size_t getCacheSize() {
         return currentCacheSize;
     }
 
-    void addCidSize(std::string cid, size_t size) {
-        ContentSizes::iterator it = contentSizes.find(cid);
-        if (it != contentSizes.end() && it->second != size) {
-            std::cout << "Another size for content. Was -> " <<  it->second
-                << " now -> "<< size 
-                << " for cid -> " << cid << std::endl;
-        }
-
-        contentSizes[cid] = size;
+    void setContentSizes(const ContentSizes *sizes) {
+        contentSizes = sizes;
     }
 
-    VecStr get_hot_content(const float &cache_hot_content) {
-        VecStr hot_content;
-        int curr_count = 0;
+    std::vector<Key> get_hot_content(const float &cache_hot_content) {
+        std::vector<Key> hot_content;
         int count = MAX((int)(cache_hot_content*elementsCount()), 1);
-        typename std::list<std::pair<Key, Value>>::reverse_iterator it = 
-                                            lruList.rbegin();
-        for (; it != lruList.rend() && curr_count++ < count; ++it) {
-            hot_content.push_back(it->first);
-        }
+        appendRecent(hot_content, count);
 
         return hot_content;
     }
 
+    // append keys from the most recently used until keys has count elements
+    void appendRecent(std::vector<Key> &keys, const size_t &count) const {
+        for (NodeIndex index = tail; index != NIL && keys.size() < count; index = nodes[index].prev) {
+            keys.push_back(nodes[index].item.first);
+        }
+    }
+
 private:
     void makeSizeInvariant(size_t size) {
         while (getCacheSize() > size) {
-            // std::cout << "make size invariant" << std::endl;
+            NodeIndex index = head;
+            const Key &key = nodes[index].item.first;
             if (evictionCallback) {
-                // std::cout << "1" << std::endl;
-                evictionCallback(lruList.front().first, lruList.front().second, 0);
+                evictionCallback(key, nodes[index].item.second, 0);
             }
 
-            // std::cout << "2" << std::endl;
-            size_t cidSize = contentSizes[lruList.front().first];
+            size_t cidSize = get_content_size(*contentSizes, key);
             currentCacheSize -= cidSize;
-            // std::cout << "3" << std::endl;
 
-            lookup.erase(lruList.front().first);
+            lookup.erase(key);
 
-            lruList.pop_front();
+            unlink(index);
+            release(index);
         }
     }
 
-    typename LruList::iterator promote(typename LruList::iterator it) {
-        lruList.push_back(*it);
+    void promote(const NodeIndex &index) {
+        if (index == tail)
+            return;
 
-        auto addedIt = --lruList.end();
-        lookup[it->first] = addedIt;
+        unlink(index);
+        linkBack(index);
+    }
+
+    NodeIndex allocate(const Key &key, const Value &value) {
+        if (freeHead == NIL) {
+            nodes.push_back(Node(key, value));
+            return NodeIndex(nodes.size() - 1);
+        }
 
-        lruList.erase(it);
+        NodeIndex index = freeHead;
+        freeHead = nodes[index].next;
+        nodes[index].item = CacheEntry<Key, Value>(key, value);
+        return index;
+    }
 
-        return addedIt;
-    }    
+    void release(const NodeIndex &index) {
+        nodes[index].prev = NIL;
+        nodes[index].next = freeHead;
+        freeHead = index;
+    }
 
-// private:
-public:
-    LruList lruList;
-    std::unordered_map<Key, typename LruList::iterator> lookup;
+    void linkBack(const NodeIndex &index) {
+        nodes[index].prev = tail;
+        nodes[index].next = NIL;
+        if (tail != NIL)
+            nodes[tail].next = index;
+        else
+            head = index;
+        tail = index;
+    }
+
+    void unlink(const NodeIndex &index) {
+        Node &node = nodes[index];
+        if (node.prev != NIL)
+            nodes[node.prev].next = node.next;
+        else
+            head = node.next;
+        if (node.next != NIL)
+            nodes[node.next].prev = node.prev;
+        else
+            tail = node.prev;
+    }
+
+private:
+    // LRU item is at head, MRU item is at tail
+    std::vector<Node> nodes;
+    NodeIndex head = NIL;
+    NodeIndex tail = NIL;
+    NodeIndex freeHead = NIL;
+
+    FlatHashMap<Key, NodeIndex> lookup;
     size_t cacheSize;
-    std::function<Value(const Key&)> getFunction;
     std::function<void(const Key &,const Value &, const size_t & current_time)> evictionCallback;
 
     size_t currentCacheSize;
-    ContentSizes contentSizes;
+    const ContentSizes *contentSizes = nullptr;
 };
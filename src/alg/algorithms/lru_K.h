@@ -1,39 +1,111 @@
 #pragma once
 
 #include "defs.h"
+#include "flat_hash_map.h"
+#include "node_pool.h"
+#include "cache_entry.h"
 #include "config.h"
 
 #include <map>
+#include <array>
+#include <queue>
+#include <set>
 #include <list>
 #include <limits>
+#include <algorithm>
 #include <cstdlib>
 #include <utility>
 #include <vector>
 #include <iostream>
 #include <functional>
-#include <unordered_map>
 
 
 #define MAX(X, Y) ((X) > (Y) ? (X) : (Y))
 
 /*
     Cache has two strategies: LRU-K and LRU (for ambiguous cases)
+
+    Candidates for eviction are resident contents referenced more than
+    the correlated reference period ago, ordered by the time of their K-th
+    last request. A referenced content is parked until its correlated
+    period expires, so a victim is the first candidate.
+
+    All state of a content is kept in one record, history of evicted
+    content is forgotten after the retained information period.
 */
 
-template <typename Key, typename Value>
+template <typename Key, typename Value, size_t K = 2>
 class LRU_K_Cache {
-    typedef std::list<std::pair<Key, Value>> LruList;
-    typedef std::unordered_map<std::string, size_t> ContentSizes;
+    typedef std::list<CacheEntry<Key, Value>, PoolAllocator<CacheEntry<Key, Value>>> LruList;
+
+    // order of candidates, time of K-th last request and sequence number
+    // of the rank, so contents with equal times are taken in order of ranking
+    struct Rank {
+        size_t oldest_request;
+        size_t sequence;
+        Key key;
+
+        bool operator < (const Rank &other) const {
+            if (oldest_request != other.oldest_request)
+                return oldest_request < other.oldest_request;
+            return sequence < other.sequence;
+        }
+    };
+
+    // parked content, it becomes a candidate after the expiration time
+    struct Parking {
+        size_t expiration;
+        size_t sequence;
+
+        bool operator < (const Parking &other) const {
+            if (expiration != other.expiration)
+                return expiration < other.expiration;
+            return sequence < other.sequence;
+        }
+    };
+
+    struct Record {
+        Record() :
+            last_request(0),
+            resident(false),
+            parked(false)
+        {
+            history.fill(0);
+        }
+
+        // history[0] - last request
+        // history[1] - penultimate request
+        // and etc.
+        std::array<size_t, K> history;
+
+        // time of last request to the content
+        size_t last_request;
+
+        // position in LRU list and rank of cached content
+        typename LruList::iterator lruIt;
+        Rank rank;
+        bool resident;
+        bool parked;
+    };
+
+    typedef FlatHashMap<Key, Record> Records;
+    typedef std::set<Rank, std::less<Rank>, PoolAllocator<Rank>> Candidates;
+    typedef std::map<Parking, Rank, std::less<Parking>, PoolAllocator<std::pair<const Parking, Rank>>> ParkingQueue;
+
+    // time after which history of evicted content is forgotten
+    typedef std::pair<size_t, Key> Expiration;
+    typedef std::priority_queue<Expiration, std::vector<Expiration>, std::greater<Expiration>> ExpirationQueue;
 public:
     LRU_K_Cache() {};
     explicit LRU_K_Cache(size_t size, const size_t & learn_limit = 100,
-                            const size_t & period = 1000, const size_t & history_len = 2) :
+                            const size_t & period = 1000) :
             cacheSize(size < 1 ? 1 : size),
-            currentCacheSize(0)
+            currentCacheSize(0),
+            latest_time(0),
+            rank_sequence(0)
     {
         correlated_reference_period = learn_limit;
         retained_information_period = period;
-        this->history_len = history_len;
     }
 
     void prepare_cache() {
@@ -41,90 +113,78 @@ public:
     }
 
     Value* find(const Key &key, const size_t & current_time = 0) {
-        auto it = lookup.find(key);
+        auto it = records.find(key);
 
-        if (it == lookup.end()) {
+        if (it == records.end() || !it->second.resident) {
             return nullptr;
         }
 
         // update LRU cache
-        Value *value = &promote(it->second)->second;
+        Record &record = it->second;
+        lruList.splice(lruList.end(), lruList, record.lruIt);
 
         // update history information
-        size_t &last_request = cid_last_request[key];
-        std::vector<size_t> &history = cid_history[key];
-        size_t oldest_request_time = history.back();
+        removeCandidate(record);
 
-        if ((current_time - last_request) > correlated_reference_period) {
+        std::array<size_t, K> &history = record.history;
+        if ((current_time - record.last_request) > correlated_reference_period) {
             /* a new, uncorreleated reference */
-            size_t correl_period_of_refd_page = last_request - history[0];
-            for (size_t i = (history.size() - 1); i >= 1; --i) {
+            size_t correl_period_of_refd_page = record.last_request - history[0];
+            for (size_t i = (K - 1); i >= 1; --i) {
                 history[i] = history[i-1] + correl_period_of_refd_page;
             }
             history[0] = current_time;
-            last_request = current_time;
+            record.last_request = current_time;
 
-            delete_value_from_multimap(oldest_request_cid_map, oldest_request_time, key);
-            oldest_request_cid_map.insert(std::pair<size_t, Key>(history.back(), key));
-            cid_oldest_request_map.insert(std::pair<Key, size_t>(key, history.back()));
+            record.rank = makeRank(key, history.back());
 
         } else {
             /* a correlated reference */
-            last_request = current_time;
+            record.last_request = current_time;
         }
 
-        return value;
+        park(record);
+
+        return &record.lruIt->second;
     }
 
     Value* put(const Key &key, const Value &value, const size_t &current_time = 0) {
-        size_t cidSize = contentSizes[key];
+        size_t cidSize = get_content_size(*contentSizes, key);
         if (cidSize > cacheSize)
             return nullptr;
+
+        forgetExpiredHistory(current_time);
         
         while ((getCacheSize() + cidSize) >  cacheSize) {
-            std::vector<typename LruList::iterator> victims = find_victims(current_time);
-            if (victims.size() == 0) {
+            auto victim = find_victim(current_time);
+            if (victim == records.end()) {
 
                 // if all elements in correlation period
                 // delete elements by LRU-1 strategy
                 makeSizeInvariant(cacheSize - cidSize, current_time);
 
-            } else if (victims.size() == 1) {
-                typename LruList::iterator it = victims[0];
-                Key victim = it->first;
+            } else {
                 if (evictionCallback) {
-                    evictionCallback(victim, victim, current_time);
+                    evictionCallback(victim->first, victim->second.lruIt->second, current_time);
                 }
-
-                size_t victimSize = contentSizes[victim];
-                currentCacheSize -= victimSize;
-
-                lruList.erase(it);
-                lookup.erase(victim);
-
+                evict(victim->second);
             }
         }
 
-        typename LruList::iterator addedIt = addCidToCache(key, value, current_time);
-        return &addedIt->second;
+        addCidToCache(key, value, current_time);
+        return &lruList.back().second;
     }
 
     bool erase(const Key &key) {
-        auto it = lookup.find(key);
+        auto it = records.find(key);
 
-        if (it == lookup.end()) {
+        if (it == records.end() || !it->second.resident) {
             return false;
         }
 
-        size_t cidSize = contentSizes[key];
-        currentCacheSize -= cidSize;
+        removeCandidate(it->second);
+        evict(it->second);
 
-        lruList.erase(it->second);
-        lookup.erase(it);
-
-        std::vector<size_t> &history = cid_history[key];
-        size_t oldest_request_time = history.back();
-        delete_value_from_multimap(oldest_request_cid_map, oldest_request_time, key);
         return true;
     }
 
@@ -137,7 +197,7 @@ public:
     }
 
     size_t elementsCount() const {
-        return lookup.size();
+        return lruList.size();
     }
 
     void setCacheSize(size_t size) {
@@ -145,38 +205,31 @@ public:
         makeSizeInvariant(cacheSize);
     }
 
-    const std::pair<Key, Value> *mruItem() const {
+    const CacheEntry<Key, Value> *mruItem() const {
         return &lruList.back();
     }
 
-    const std::pair<Key, Value> *lruItem() const {
+    const CacheEntry<Key, Value> *lruItem() const {
         return &lruList.front();
     }
 
-    ContentSizes getContentSizes() {
-        return contentSizes;
+    const ContentSizes & getContentSizes() const {
+        return *contentSizes;
     }
 
     size_t getCacheSize() {
         return currentCacheSize;
     }
 
-    void addCidSize(std::string cid, size_t size) {
-        ContentSizes::iterator it = contentSizes.find(cid);
-        if (it != contentSizes.end() && it->second != size) {
-            std::cout << "Another size for content. Was -> " <<  it->second
-                << " now -> "<< size 
-                << " for cid -> " << cid << std::endl;
-        }
-
-        contentSizes[cid] = size;
+    void setContentSizes(const ContentSizes *sizes) {
+        contentSizes = sizes;
     }
 
-    VecStr get_hot_content(const float &cache_hot_content) {
-        VecStr hot_content;
+    std::vector<Key> get_hot_content(const float &cache_hot_content) {
+        std::vector<Key> hot_content;
         int curr_count = 0;
         int count = MAX((int)(cache_hot_content*elementsCount()), 1);
-        typename std::list<std::pair<Key, Value>>::reverse_iterator it = 
+        typename LruList::reverse_iterator it = 
                                             lruList.rbegin();
         for (; it != lruList.rend() && curr_count++ < count; ++it) {
             hot_content.push_back(it->first);
@@ -188,119 +241,144 @@ public:
 private:
     void makeSizeInvariant(size_t size, const size_t & current_time = 0) {
         while (getCacheSize() > size) {
+            const Key key = lruList.front().first;
             if (evictionCallback) {
-                evictionCallback(lruList.front().first, 
+                evictionCallback(key, 
                                  lruList.front().second, 
                                  current_time);
             }
 
-            size_t cidSize = contentSizes[lruList.front().first];
-            currentCacheSize -= cidSize;
-
-            lookup.erase(lruList.front().first);
-
-            lruList.pop_front();
+            Record &record = records.find(key)->second;
+            removeCandidate(record);
+            evict(record);
         }
     }
 
-    void delete_value_from_multimap(typename std::multimap<size_t, Key> &mmap,
-                                    const size_t &key, 
-                                    const Key &value) {
-        std::pair <typename std::multimap<size_t, Key>::iterator, 
-                   typename std::multimap<size_t, Key>::iterator > ret;
-        ret = mmap.equal_range(key);
-        typename std::multimap<size_t, Key>::iterator it;
-        for (it = ret.first; it != ret.second; ++it) {
-            if (it->second == value) {
-                mmap.erase(it);
-                break;
-            }
-        }
+    // record of evicted content keeps history for the retained information period
+    void evict(Record &record) {
+        const Key key = record.lruIt->first;
+        currentCacheSize -= get_content_size(*contentSizes, key);
+
+        lruList.erase(record.lruIt);
+        record.resident = false;
+        expiration_queue.push(std::make_pair(record.last_request + retained_information_period, key));
     }
 
-    typename LruList::iterator addCidToCache(const Key & key, 
-                                             const Value & value, 
-                                             const size_t & current_time) {
-        size_t cidSize = contentSizes[key];
-        lruList.push_back(std::make_pair(key, value));
-        auto addedIt = --lruList.end();
-        lookup[key] = addedIt;
-        currentCacheSize += cidSize;
+    void forgetExpiredHistory(const size_t &current_time) {
+        while (!expiration_queue.empty() && expiration_queue.top().first < current_time) {
+            Key key = expiration_queue.top().second;
+            expiration_queue.pop();
 
-        // update history for old cid
-        // or add history for new cid 
+            // content may be cached or requested again since it was evicted
+            auto it = records.find(key);
+            if (it == records.end() || it->second.resident ||
+                (it->second.last_request + retained_information_period) >= current_time)
+                continue;
 
-        auto it = cid_history.find(key);
-        if (it == cid_history.end()) {
-            std::vector<size_t> v(history_len, 0);
-            cid_history[key] = v;
-            oldest_request_cid_map.insert(std::pair<size_t, Key>(0, key));;
-            cid_oldest_request_map[key] = 0;
-        } else {
-            size_t oldest_request_time = cid_history[key].back();
-            for (size_t i = (history_len - 1); i >= 1; --i) {
-                cid_history[key][i] = cid_history[key][i-1];
-            }
-            delete_value_from_multimap(oldest_request_cid_map, oldest_request_time, key);
-            oldest_request_cid_map.insert(std::pair<size_t, Key>(cid_history[key].back(), key));
-            cid_oldest_request_map[key] = cid_history[key].back();
+            records.erase(it);
         }
+    }
 
-        cid_history[key][0] = current_time;
-        cid_last_request[key] = current_time;
-        return addedIt;
+    Rank makeRank(const Key &key, const size_t &oldest_request) {
+        Rank rank;
+        rank.oldest_request = oldest_request;
+        rank.sequence = rank_sequence++;
+        rank.key = key;
+        return rank;
     }
 
-    std::vector<typename LruList::iterator> find_victims(const size_t & current_time) {
-        // return null, one cid with minimal HIST(cid, k)
-        std::vector<typename LruList::iterator> victims;
-        
-        typename LruList::iterator cid1, cid2;
-        cid1 = cid2 = lruList.end();
+    // content is not a candidate until its correlated period expires
+    void park(Record &record) {
+        Parking parking;
+        parking.expiration = record.last_request + correlated_reference_period;
+        parking.sequence = record.rank.sequence;
+        parking_queue.insert(std::make_pair(parking, record.rank));
+        record.parked = true;
+        latest_time = std::max(latest_time, record.last_request);
+    }
 
-        typename std::multimap<size_t, Key>::iterator it;
-        for (it = oldest_request_cid_map.begin(); it != oldest_request_cid_map.end(); ++it) {
-            Key cid = it->second;
-            if (lookup.find(cid) == lookup.end())
-                continue;
+    void removeCandidate(const Record &record) {
+        if (record.parked) {
+            Parking parking;
+            parking.expiration = record.last_request + correlated_reference_period;
+            parking.sequence = record.rank.sequence;
+            parking_queue.erase(parking);
+        } else {
+            candidates.erase(record.rank);
+        }
+    }
 
-            size_t last_request = cid_last_request[cid];
-            if ((current_time - last_request) <= correlated_reference_period)
-                continue;
+    void addCidToCache(const Key & key, 
+                       const Value & value, 
+                       const size_t & current_time) {
+        size_t cidSize = get_content_size(*contentSizes, key);
+        lruList.push_back(CacheEntry<Key, Value>(key, value));
+        currentCacheSize += cidSize;
 
-            // cid is out of corr_ref_period
-            cid1 = lookup[cid];
-            break;
+        // update history for old cid
+        // or add history for new cid 
+        Record &record = records[key];
+        std::array<size_t, K> &history = record.history;
+        for (size_t i = (K - 1); i >= 1; --i) {
+            history[i] = history[i-1];
         }
 
-        if (cid1 != lruList.end()) {
-            oldest_request_cid_map.erase(it);
-            victims.push_back(cid1);
-        }
-        
-        if (cid2 != lruList.end()) {
-            oldest_request_cid_map.erase(it);
-            victims.push_back(cid2);
-        }
+        // the rank is HIST(cid, K) with this request, for K = 1 it is the request itself
+        history[0] = current_time;
+        record.last_request = current_time;
 
-        return victims;
+        record.lruIt = --lruList.end();
+        record.resident = true;
+        record.rank = makeRank(key, history.back());
+        park(record);
     }
 
-    typename LruList::iterator promote(typename LruList::iterator it) {
-        lruList.push_back(*it);
+    bool eligible(const size_t &last_request, const size_t &current_time) const {
+        return (current_time - last_request) > correlated_reference_period;
+    }
 
-        auto addedIt = --lruList.end();
-        lookup[it->first] = addedIt;
+    // resident with minimal HIST(cid, k) out of its correlated period
+    typename Records::iterator find_victim(const size_t & current_time) {
+        const Rank *best = nullptr;
+
+        if (current_time >= latest_time) {
+            latest_time = current_time;
+            while (!parking_queue.empty() && parking_queue.begin()->first.expiration < current_time) {
+                const Rank &rank = parking_queue.begin()->second;
+                candidates.insert(rank);
+                records.find(rank.key)->second.parked = false;
+                parking_queue.erase(parking_queue.begin());
+            }
+            if (!candidates.empty())
+                best = &*candidates.begin();
+        } else {
+            // requests earlier than the latest one (pre push) may see
+            // any content as out of its correlated period
+            for (const Rank &rank : candidates) {
+                if (eligible(records.find(rank.key)->second.last_request, current_time)) {
+                    best = &rank;
+                    break;
+                }
+            }
+            for (const auto &element : parking_queue) {
+                const Rank &rank = element.second;
+                if ((best == nullptr || rank < *best) &&
+                    eligible(records.find(rank.key)->second.last_request, current_time))
+                    best = &rank;
+            }
+        }
 
-        lruList.erase(it);
+        if (best == nullptr)
+            return records.end();
 
-        return addedIt;
+        auto victim = records.find(best->key);
+        removeCandidate(victim->second);
+        return victim;
     }
 
-// private:
-public:
+private:
     LruList lruList;
-    std::unordered_map<Key, typename LruList::iterator> lookup;
+    Records records;
     std::function<void(const Key &,const Value &, const size_t & current_time)> evictionCallback;
 
 
@@ -308,22 +386,15 @@ public:
     size_t currentCacheSize;
     size_t correlated_reference_period;
     size_t retained_information_period;
-    
-    // history_len is a parameter K in LRU-K
-    size_t history_len;
-    
-    // time of last request to the content
-    std::unordered_map<Key, size_t> cid_last_request;
-
-    // history of requests to the cid
-    // cid_history[0] - last request
-    // cid_history[1] - penultimate request
-    // and etc.
-    std::unordered_map<Key, std::vector<size_t>> cid_history;
-
-    // data structures for search cids with minimal oldest request
-    std::multimap<size_t, Key> oldest_request_cid_map;
-    std::unordered_map<Key, size_t> cid_oldest_request_map;
-
-    ContentSizes contentSizes;
+
+    // resident contents out of and in the correlated period
+    Candidates candidates;
+    ParkingQueue parking_queue;
+    size_t latest_time;
+    size_t rank_sequence;
+
+    // evicted contents in order of expiration of their history
+    ExpirationQueue expiration_queue;
+
+    const ContentSizes *contentSizes = nullptr;
 };
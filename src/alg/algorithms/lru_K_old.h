@@ -200,7 +200,7 @@ public:
         return &lruList.front();
     }
 
-    ContentSizes getContentSizes() {
+    const ContentSizes & getContentSizes() const {
         return contentSizes;
     }
 
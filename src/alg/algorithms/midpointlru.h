@@ -9,7 +9,6 @@
 
 template <typename Key, typename Value>
 class MidPointLRUCache {
-    typedef std::unordered_map<std::string, size_t> ContentSizes;
 public:
     MidPointLRUCache() {};
     explicit MidPointLRUCache(size_t size, const size_t & learn_limit = 100, const size_t & period = 1000, float point = 0.85) :
@@ -79,8 +78,8 @@ public:
         tail.setCacheSize(cacheSize - head.size());
     }
 
-    ContentSizes getContentSizes() {
-        return contentSizes;
+    const ContentSizes & getContentSizes() const {
+        return *contentSizes;
     }
 
     size_t getCacheSize() {
@@ -88,22 +87,15 @@ public:
         return currentCacheSize;
     }
 
-    void addCidSize(std::string cid, size_t size) {
-        ContentSizes::iterator it = contentSizes.find(cid);
-        if (it != contentSizes.end() && it->second != size) {
-            std::cout << "Another size for content. Was -> " <<  it->second
-                << " now -> "<< size 
-                << " for cid -> " << cid << std::endl;
-        }
-
-        contentSizes[cid] = size;
+    void setContentSizes(const ContentSizes *sizes) {
+        contentSizes = sizes;
 
-        head.addCidSize(cid, size);
-        tail.addCidSize(cid, size);
+        head.setContentSizes(sizes);
+        tail.setContentSizes(sizes);
     }
 
-    VecStr get_hot_content(const float &cache_hot_content) {
-        return VecStr();
+    std::vector<Key> get_hot_content(const float &cache_hot_content) {
+        return std::vector<Key>();
     }
 
 private:
@@ -112,5 +104,5 @@ private:
     size_t headSize;
     LRUCache<Key, Value> tail;
     LRUCache<Key, Value> head;
-    ContentSizes contentSizes;
+    const ContentSizes *contentSizes = nullptr;
 };
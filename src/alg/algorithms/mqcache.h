@@ -10,7 +10,6 @@
 
 template <typename Key, typename Value>
 class MQCache {
-    typedef std::unordered_map<std::string, size_t> ContentSizes;
 
     struct ValueHolder {
         ValueHolder() :
@@ -70,7 +69,7 @@ public:
                     valueHolder = lruList[lruIndex].put(key, *valueHolder);
                     lruList[index].erase(key);
 
-                    assert(size() <= cacheSize);
+                    assert(getCacheSize() <= cacheSize);
                 }
 
                 return &valueHolder->value;
@@ -99,10 +98,14 @@ public:
             return result;
         }
 
+        size_t cidSize = get_content_size(*contentSizes, key);
+        if (cidSize > cacheSize)
+            return nullptr;
+
         ++currentTime;
 
-        makeSizeInvariant(cacheSize - 1);
-        assert(size() <= cacheSize - 1);
+        makeSizeInvariant(cacheSize - cidSize);
+        assert(getCacheSize() <= cacheSize - cidSize);
 
         auto *outValue = out.find(key);
 
@@ -133,49 +136,53 @@ public:
     }
 
     size_t size() const {
-        size_t sz = 0;
-        for (const auto& lru : lruList) {
-            sz += lru.size();
-        }
-
-        return sz;
+        // limit of cache size
+        return cacheSize;
     }
 
     size_t elementsCount() const {
-        return 0;
+        size_t result = 0;
+        for (const auto& lru : lruList) {
+            result += lru.elementsCount();
+        }
+
+        return result;
     }
 
     void setEvictionCallback(std::function<void(const Key &,const Value &)> callback) {
         evictionCallback = callback;
     }
 
-    ContentSizes getContentSizes() {
-        return contentSizes;
+    const ContentSizes & getContentSizes() const {
+        return *contentSizes;
     }
 
     size_t getCacheSize() {
-        return currentCacheSize;
+        size_t result = 0;
+        for (auto& lru : lruList) {
+            result += lru.getCacheSize();
+        }
+
+        return result;
     }
 
-    void addCidSize(std::string cid, size_t size) {
-        ContentSizes::iterator it = contentSizes.find(cid);
-        if (it != contentSizes.end() && it->second != size) {
-            std::cout << "Another size for content. Was -> " <<  it->second
-                << " now -> "<< size 
-                << " for cid -> " << cid << std::endl;
-        }
+    void setContentSizes(const ContentSizes *sizes) {
+        contentSizes = sizes;
 
-        contentSizes[cid] = size;
+        for (auto & lru : lruList) {
+            lru.setContentSizes(sizes);
+        }
+        out.setContentSizes(sizes);
     }
 
-    VecStr get_hot_content(const float &cache_hot_content) {
-        return VecStr();
+    std::vector<Key> get_hot_content(const float &cache_hot_content) {
+        return std::vector<Key>();
     }
 
 private:
     void checkFrequentExpariation() {
         for (int i = lruList.size() - 1; i > 0; --i) {
-            if (lruList[i].size() == 0) {
+            if (lruList[i].elementsCount() == 0) {
                 continue;
             }
 
@@ -186,17 +193,12 @@ private:
             }
         }
 
-        assert(size() <= cacheSize);
+        assert(getCacheSize() <= cacheSize);
     }
 
     void makeSizeInvariant(size_t newSize) {
-        if (size() <= newSize) {
-            return;
-        }
-
-        size_t itemsToRemove = size() - newSize;
         for (auto& lru : lruList) {
-            while (lru.size() > 0 && itemsToRemove > 0) {
+            while (lru.elementsCount() > 0 && getCacheSize() > newSize) {
                 auto item = lru.lruItem();
                 out.put(item->first, std::make_pair(item->second.reqs, item->second.reqTime));
 
@@ -205,10 +207,9 @@ private:
                 }
 
                 lru.erase(lru.lruItem()->first);
-                --itemsToRemove;
             }
 
-            if (itemsToRemove == 0) {
+            if (getCacheSize() <= newSize) {
                 return;
             }
         }
@@ -235,7 +236,6 @@ private:
 
 private:
     size_t cacheSize;
-    size_t currentCacheSize;
     size_t expireTime;
     size_t currentTime;
 
@@ -247,5 +247,5 @@ private:
 
     std::function<void(const Key &,const Value &)> evictionCallback;
 
-    ContentSizes contentSizes;
+    const ContentSizes *contentSizes = nullptr;
 };
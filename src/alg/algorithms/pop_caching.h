@@ -1,9 +1,14 @@
 #pragma once
 
+#include "defs.h"
+#include "flat_hash_map.h"
+#include "indexed_heap.h"
+#include "worker_pool.h"
+
 #include <set>
+#include <array>
 #include <list>
 #include <cmath>
-#include <queue>
 #include <vector>
 #include <cstdlib>
 #include <cassert>
@@ -32,32 +37,24 @@
 
 
 
-template<typename T>
-class custom_priority_queue : public std::priority_queue<T, std::vector<T>>
-{
-public:
-    bool remove(const T& value) {
-        auto it = std::find(this->c.begin(), this->c.end(), value);
-        if (it != this->c.end()) {
-            this->c.erase(it);
-            std::make_heap(this->c.begin(), this->c.end(), this->comp);
-            return true;
-        } else {
-            return false;
-        }
-    }
-};
-
+// context vector is the normalized access stat vector,
+// coordinate i is the i-th time feature
+template <size_t D>
+using ContextVector = std::array<double, D>;
 
-// context vector is the normalized access stat vector
-typedef std::unordered_map<std::string, double> ContextVector;
-typedef std::unordered_map<std::string, std::pair<double, double>> Bounds;
+// edges of a hypercube in every direction
+template <size_t D>
+struct Bounds {
+    std::array<double, D> left;
+    std::array<double, D> right;
+};
 
+template <size_t D>
 class HyperCube {
 public:
     HyperCube () {}
     HyperCube(  const size_t & l, const size_t & c, 
-                const size_t sum, const Bounds & b)
+                const size_t sum, const Bounds<D> & b)
     {
         level = l;
         capacity = c;
@@ -73,17 +70,15 @@ public:
 
         // result = true;
 
-        for (auto & bound : bounds) {
-            if (fabs(bound.second.second - bound.second.first) < OVERFLOW_EPS) {
-                result = false;
-                break;
-            }
-        }
+        // no early exit, so the loop is vectorized
+        bool narrow = false;
+        for (size_t i = 0; i < D; ++i)
+            narrow |= fabs(bounds.right[i] - bounds.left[i]) < OVERFLOW_EPS;
 
-        return result;
+        return !narrow;
     }
 
-    size_t get_estimation() {
+    size_t get_estimation() const {
         if (capacity == 0 && sum_of_request_rate == 0)
             return 1;
 
@@ -99,18 +94,12 @@ public:
         return result;
     }
 
-    bool contain(ContextVector & x) {
-        for (auto & bound : bounds) {
-            std::string direction = bound.first;
-            double left = bound.second.first;
-            double right = bound.second.second;
+    bool contain(const ContextVector<D> & x) const {
+        bool inside = true;
+        for (size_t i = 0; i < D; ++i)
+            inside &= (x[i] >= bounds.left[i]) & (x[i] <= bounds.right[i]);
 
-            if ((x[direction] >= left && x[direction] <= right) == false) {
-                return false;
-            }
-        }
-
-        return true;
+        return inside;
     }
 
     bool operator == (const HyperCube & other) const {
@@ -122,42 +111,24 @@ public:
         if (result == false)
             return result;
         
-        bool flag = true;
-
-        Bounds other_bounds = other.get_bounds();
-
-        for (auto & bound : bounds) {
-            std::string direction = bound.first;
-            double left = bound.second.first;
-            double right = bound.second.second;
-            double left_other = other_bounds[direction].first;
-            double right_other = other_bounds[direction].second;
-            if (fabs(left - left_other) > EPS || fabs(right - right_other) > EPS) {
-                flag = false;
-                break;
-            }
-        }
+        const Bounds<D> & other_bounds = other.get_bounds();
 
-        if (flag == false)
-            return false;
+        bool differ = false;
+        for (size_t i = 0; i < D; ++i) {
+            differ |= fabs(bounds.left[i] - other_bounds.left[i]) > EPS;
+            differ |= fabs(bounds.right[i] - other_bounds.right[i]) > EPS;
+        }
 
-        return true;
+        return !differ;
     }
 
-    friend std::ostream & operator << (std::ostream & out, const HyperCube & h) {
-        Bounds bounds = h.get_bounds();
-        if (bounds.size() == 0) {
-            std::cout << "Hypercube is empty" << std::endl;
-            return out;
-        }
-
-        std::cout << "hypecube" << std::endl;
-        for (auto & bound : bounds) {
-            out << bound.first << ' ' << '<' <<
-                bound.second.first << ' ' << bound.second.second << "> ";
+    // directions are the names of the time features
+    void print(std::ostream & out, const std::vector<std::string> & directions) const {
+        out << "hypecube" << std::endl;
+        for (size_t i = 0; i < D; ++i) {
+            out << directions[i] << ' ' << '<' <<
+                bounds.left[i] << ' ' << bounds.right[i] << "> ";
         }
-
-        return out;
     }
 
     void add_capacity(const size_t & delta) {
@@ -180,7 +151,7 @@ public:
         return level;
     }
 
-    Bounds get_bounds() const {
+    const Bounds<D> & get_bounds() const {
         return bounds;
     }
 
@@ -192,14 +163,15 @@ private:
 
     size_t sum_of_request_rate;
 
-    Bounds bounds;
+    Bounds<D> bounds;
 };
 
 
-void print_context_vector(const ContextVector & x) {
+template <size_t D>
+void print_context_vector(const ContextVector<D> & x) {
     std::cout << "context vector" << std::endl;
-    for (auto & elem : x) {
-        std::cout << elem.first << ' ' << elem.second << ' ';
+    for (size_t i = 0; i < D; ++i) {
+        std::cout << i << ' ' << x[i] << ' ';
     }
     std::cout << std::endl;
     std::cout << std::endl;
@@ -207,315 +179,252 @@ void print_context_vector(const ContextVector & x) {
 
 
 
-struct ContextTreeNode {
-    ContextTreeNode() {
-        hypercube = nullptr;
-    }
-    ~ContextTreeNode() {
-        // std::cout << "~ContextTreeNode()" << std::endl;
-        if (hypercube != nullptr)
-            delete hypercube;
-        // for (auto & child : child_nodes)
-        //     delete child
-        for (int i = child_nodes.size() - 1; i >= 0 ; --i) {
-            if (child_nodes[i] != nullptr)
-                delete child_nodes[i];
-        }
-    }
-
-    HyperCube * hypercube;
-    std::vector<ContextTreeNode *> child_nodes;
-};
-
-typedef ContextTreeNode * ContextTree;
-
+/*
+    Context tree is kept in one array of nodes. A split halves every
+    direction of a hypercube, so its 2^D children are stored together and
+    child i takes the upper half of direction d if bit d of i is set.
+    A lookup goes down one level per step by comparing the vector with
+    the middles of the node.
 
+    By default the tree stops splitting when it has DEFAULT_BUDGET nodes.
+    With a budget set, a split of a full tree first merges the coldest
+    node whose children are all leaves back into a leaf, if nothing was
+    learned in its children since the last learning in the hypercube to
+    split. Blocks of merged children are reused.
+*/
+template <size_t D>
 class ContextSpace {
-    typedef ContextTreeNode * ContextTree;
-    typedef std::unordered_map<std::string, size_t> CidLongLong;
+    struct Node {
+        Node(const HyperCube<D> & hypercube, const size_t & parent, const size_t & last_update) :
+            hypercube(hypercube),
+            first_child(NO_CHILDREN),
+            parent(parent),
+            last_update(last_update) {}
+
+        HyperCube<D> hypercube;
+
+        // children are nodes [first_child, first_child + 2^D)
+        size_t first_child;
+        size_t parent;
+
+        // time of the last learning in the hypercube or in its children,
+        // merged children leave their time to it
+        size_t last_update;
+    };
+
 public:
+    static const size_t NOT_FOUND = SIZE_MAX;
+    static const size_t DEFAULT_BUDGET = 10000;
+
     ContextSpace() {
         z1 = z2 = 0;
         context_tree_size = 0;
         max_level = 0;
-        context_tree = nullptr;
-    }
-    ~ContextSpace() {
-        // std::cout << "~ContextSpace()" << std::endl;
-        if (context_tree != nullptr)
-            delete context_tree;
+        budget = DEFAULT_BUDGET;
+        merging = false;
     }
 
     ContextSpace(std::vector<std::string> time_features,
                 const size_t & c1, const size_t & c2) :
-        z1(c1), z2(c2), context_tree_size(0), max_level(0)
+        z1(c1), z2(c2), context_tree_size(0), max_level(0), budget(DEFAULT_BUDGET), merging(false)
     {
-        Bounds bounds;
+        Bounds<D> bounds;
         directions = time_features;
-        for (auto & feature : time_features) {
-            std::pair<double, double> edge;
-            edge.first = 0.0;
-            edge.second = 1.0;
-            bounds[feature] = edge;
-        }
+        bounds.left.fill(0.0);
+        bounds.right.fill(1.0);
 
-        HyperCube * hypercube = new HyperCube(0, 1, 0, bounds);
-
-        context_tree = new ContextTreeNode();
-        context_tree->hypercube = hypercube;
+        nodes.push_back(Node(HyperCube<D>(0, 1, 0, bounds), NO_PARENT, 0));
         context_tree_size += 1;
     }
 
-    // HyperCube * find_hypercube(ContextVector & x) {
-    //     // std::cout << "find_hypercube1" << std::endl;
-    //     // print_context_space();
-
-    //     // print_context_vector(x);
-    //     for (auto & hypercube : hypercubes) {
-    //         if (hypercube.contain(x))
-    //             return &hypercube;
-    //     }
-
-    //     // std::cout << "find_hypercube2" << std::endl;
-        
-    //     print_context_space();
-    //     std::cout << "hypercubes.size() -> " << hypercubes.size() << std::endl;
-    //     print_context_vector(x);
-
-
-    //     return nullptr;
-    // }
-
+    // maximal count of nodes in the tree kept by merging, set before learning
+    void set_budget(const size_t & budget) {
+        this->budget = budget;
+        merging = true;
+    }
 
-    ContextTree find_hypercube_in_tree(ContextTree tree, ContextVector & x) {
-        if (tree == nullptr)
-            return nullptr;
+    // index of the leaf which contains x
+    size_t find_hypercube(const ContextVector<D> & x) const {
+        if (nodes.empty() || nodes[0].hypercube.contain(x) == false)
+            return NOT_FOUND;
 
-        HyperCube * hypercube = tree->hypercube;
-        std::vector<ContextTreeNode *> child_nodes = tree->child_nodes;
+        size_t node = 0;
+        while (nodes[node].first_child != NO_CHILDREN) {
+            const Bounds<D> & bounds = nodes[node].hypercube.get_bounds();
 
-        if (hypercube->contain(x) == false)
-            return nullptr;
+            // a point on the middle belongs to the lower half,
+            // it was the first child to contain it
+            size_t child = 0;
+            for (size_t i = 0; i < D; ++i) {
+                double middle = bounds.left[i] + (bounds.right[i] - bounds.left[i]) / 2;
+                child |= size_t(x[i] > middle) << i;
+            }
 
-        if (child_nodes.empty()) {
-            // std::cout << "find_hypercube1" << std::endl;
-            return tree;
+            node = nodes[node].first_child + child;
         }
 
-        // current node is not a leaf
-        // child_nodes is not empty then go into tree
-
-        ContextTree next = nullptr;
+        return node;
+    }
 
-        for (auto & child : child_nodes) {
-            if (child->hypercube->contain(x)) {
-                next = child;
-                break;
-            }
-        }
+    HyperCube<D> & get_hypercube(const size_t & node) {
+        return nodes[node].hypercube;
+    }
 
-        if (next == nullptr)
-            return nullptr;
+    // learn a content with total_requests in the leaf and split it if it overflows
+    void learn(const size_t & node, const size_t & total_requests, const size_t & current_time) {
+        HyperCube<D> & hypercube = nodes[node].hypercube;
+        hypercube.add_capacity(1);
+        hypercube.add_sum_of_requests(total_requests);
 
-        return find_hypercube_in_tree(next, x);
+        touch(node, current_time);
+        split(node);
     }
 
-    void init_splitter(std::string & splitter) {
-        size_t dimension = directions.size();
-        for (size_t i = 0; i < dimension; ++i) {
-            splitter.push_back('0');
+    void print_context_space(const size_t & node = 0) {
+        // print hypercubes in leaf of context_tree
+        std::cout << "context space" << std::endl;
+        if (node >= nodes.size()) {
+            std::cout << "Empty context tree" << std::endl;
+            return;
         }
-    }
-
-    bool splitter_exhausted(std::string & splitter) {
-        bool overflow = true;
-        for (size_t i = 0; i < splitter.length(); ++i) {
-            if (overflow == false)
-                break;
 
-            if (splitter[i] == '0') {
-                splitter[i] = '1';
-                overflow = false;
-            } else {
-                // splitter[i] == 1
-                splitter[i] = '0';
-            }
+        if (nodes[node].first_child != NO_CHILDREN) {
+            for (size_t child = 0; child < CHILDREN_COUNT; ++child)
+                print_context_space(nodes[node].first_child + child);
+            return;
         }
 
-        if (overflow)
-            return true;
-
-        return false;
+        nodes[node].hypercube.print(std::cout, directions);
+        std::cout << std::endl;
+        return;
     }
 
-    // void create_new_hypercube(const size_t & level, const size_t & capacity, 
-    //             const size_t & sum, Bounds & bounds, std::string & splitter)
-    // {
-    //     // std::cout << "create_new_hypercube" << std::endl;
-
-    //     Bounds new_bounds;
-
-    //     // std::cout << level << ' ' << capacity << ' ' << sum << std::endl;
+    size_t size() {
+        return context_tree_size;
+    }
 
-    //     for (size_t i = 0; i < splitter.length(); ++i) {
-    //         std::string direction = directions[i];
-    //         double left = 0.0;
-    //         double right = 0.0;
-    //         std::pair<double, double> pair;
-            
-    //         double delta = bounds[direction].second - bounds[direction].first;
-    //         // may be check if delta < 0
-    //         // it may be if delta is very small
+    size_t get_max_level() {
+        return max_level;
+    }
 
-    //         if (splitter[i] == '1') {
+private:
+    static const size_t NO_CHILDREN = SIZE_MAX;
+    static const size_t NO_PARENT = SIZE_MAX;
+    static const size_t CHILDREN_COUNT = size_t(1) << D;
 
-    //             left =  bounds[direction].first + delta / 2;
-    //             right = bounds[direction].second;
-    //         } else {
-    //             left = bounds[direction].first;
-    //             right = bounds[direction].first + delta/ 2;
-    //         }
+    void touch(const size_t & node, const size_t & current_time) {
+        nodes[node].last_update = std::max(nodes[node].last_update, current_time);
 
-    //         pair = std::make_pair(left, right);
-    //         new_bounds[direction] = pair;
-    //     }
+        size_t parent = nodes[node].parent;
+        if (parent == NO_PARENT)
+            return;
 
-    //     HyperCube new_hypercube = HyperCube(level + 1, capacity, sum, new_bounds);
-    //     // std::cout << new_hypercube << std::endl;
-    //     hypercubes.push_back(new_hypercube);
-    // }
+        nodes[parent].last_update = std::max(nodes[parent].last_update, current_time);
+        if (merging && mergeable.contains(parent))
+            mergeable.push(parent, nodes[parent].last_update);
+    }
 
-    // void split(HyperCube * hypercube) {
-    //     if (hypercube->overflow(z1, z2) == false)
-    //         return;
+    void split(const size_t & node) {
+        if (nodes[node].hypercube.overflow(z1, z2) == false)
+            return;
 
-    //     if (hypercubes.size() >= 10000)
-    //         return;
+        if (!merging && context_tree_size >= budget)
+            return;
 
-    //     // std::cout << "splitting" << std::endl;
-    //     // std::cout << *hypercube << std::endl;
+        if (merging && context_tree_size + CHILDREN_COUNT > budget) {
+            // the node itself is a leaf, so the coldest one is not its parent
+            if (mergeable.empty() || mergeable.top().second >= nodes[node].last_update)
+                return;
+            size_t coldest = mergeable.top().first;
+            merge(coldest);
+            if (context_tree_size + CHILDREN_COUNT > budget)
+                return;
+        }
 
-    //     std::string splitter;
-    //     init_splitter(splitter);
+        // std::cout << "splitting" << std::endl;
 
-    //     Bounds bounds = hypercube->get_bounds();
-    //     size_t level = hypercube->get_level();
-    //     size_t capacity = hypercube->get_capacity();
-    //     size_t sum = hypercube->get_sum_of_request();
+        size_t first_child = nodes.size();
+        if (free_blocks.empty()) {
+            for (size_t child = 0; child < CHILDREN_COUNT; ++child)
+                nodes.push_back(Node(create_child(nodes[node].hypercube, child),
+                                     node, nodes[node].last_update));
+        } else {
+            first_child = free_blocks.back();
+            free_blocks.pop_back();
+            for (size_t child = 0; child < CHILDREN_COUNT; ++child)
+                nodes[first_child + child] = Node(create_child(nodes[node].hypercube, child),
+                                                  node, nodes[node].last_update);
+        }
+        nodes[node].first_child = first_child;
+        context_tree_size += CHILDREN_COUNT;
 
-    //     auto it = find(hypercubes.begin(), hypercubes.end(), *hypercube);
-    //     hypercubes.erase(it);
+        if (!merging)
+            return;
 
+        // children of the parent are not all leaves now
+        mergeable.push(node, nodes[node].last_update);
+        if (nodes[node].parent != NO_PARENT)
+            mergeable.erase(nodes[node].parent);
+    }
 
-    //     create_new_hypercube(level, capacity, sum, bounds, splitter);
+    // children of the node are leaves, their statistics go back to the node
+    void merge(const size_t & node) {
+        HyperCube<D> & hypercube = nodes[node].hypercube;
+        size_t capacity = hypercube.get_capacity();
+        size_t sum = hypercube.get_sum_of_request();
 
-    //     while (!splitter_exhausted(splitter)) {
-    //         create_new_hypercube(level, capacity, sum, bounds, splitter);
-    //     }
+        size_t first_child = nodes[node].first_child;
+        for (size_t child = first_child; child < first_child + CHILDREN_COUNT; ++child) {
+            // children started with the statistics of the node
+            hypercube.add_capacity(nodes[child].hypercube.get_capacity() - capacity);
+            hypercube.add_sum_of_requests(nodes[child].hypercube.get_sum_of_request() - sum);
+        }
 
-    //     // print_context_space();
-    // }
+        nodes[node].first_child = NO_CHILDREN;
+        free_blocks.push_back(first_child);
+        context_tree_size -= CHILDREN_COUNT;
+        mergeable.erase(node);
 
-    
-    void create_new_hypercube_in_tree(ContextTreeNode * node, std::string & splitter) {
-        HyperCube * hypercube = node->hypercube;
+        size_t parent = nodes[node].parent;
+        if (parent == NO_PARENT)
+            return;
 
-        Bounds bounds = hypercube->get_bounds();
-        size_t level = hypercube->get_level();
-        size_t capacity = hypercube->get_capacity();
-        size_t sum = hypercube->get_sum_of_request();
+        size_t parent_first_child = nodes[parent].first_child;
+        // learning in the children of the node reached the node only
+        nodes[parent].last_update = std::max(nodes[parent].last_update, nodes[node].last_update);
 
-        Bounds new_bounds;
+        for (size_t child = parent_first_child; child < parent_first_child + CHILDREN_COUNT; ++child) {
+            if (nodes[child].first_child != NO_CHILDREN)
+                return;
+        }
+        mergeable.push(parent, nodes[parent].last_update);
+    }
 
-        // std::cout << level << ' ' << capacity << ' ' << sum << std::endl;
+    HyperCube<D> create_child(HyperCube<D> & hypercube, const size_t & child) {
+        const Bounds<D> & bounds = hypercube.get_bounds();
+        Bounds<D> new_bounds;
 
-        for (size_t i = 0; i < splitter.length(); ++i) {
-            std::string direction = directions[i];
-            double left = 0.0;
-            double right = 0.0;
-            std::pair<double, double> pair;
-            
-            double delta = bounds[direction].second - bounds[direction].first;
+        for (size_t i = 0; i < D; ++i) {
+            double delta = bounds.right[i] - bounds.left[i];
             // may be check if delta < 0
             // it may be if delta is very small
             // may be rounding errors
 
-            if (splitter[i] == '1') {
-
-                left =  bounds[direction].first + delta / 2;
-                right = bounds[direction].second;
+            if ((child >> i) & 1) {
+                new_bounds.left[i] = bounds.left[i] + delta / 2;
+                new_bounds.right[i] = bounds.right[i];
             } else {
-                left = bounds[direction].first;
-                right = bounds[direction].first + delta/ 2;
+                new_bounds.left[i] = bounds.left[i];
+                new_bounds.right[i] = bounds.left[i] + delta / 2;
             }
-
-            pair = std::make_pair(left, right);
-            new_bounds[direction] = pair;
         }
 
-        size_t new_level = level + 1;
-        HyperCube * new_hypercube = new HyperCube(new_level, capacity, sum, new_bounds);
-        // std::cout << *new_hypercube << std::endl;
+        size_t new_level = hypercube.get_level() + 1;
         if (new_level > max_level)
             max_level = new_level;
 
-        ContextTreeNode * new_node = new ContextTreeNode();
-        new_node->hypercube = new_hypercube;
-        node->child_nodes.push_back(new_node);
-    }
-
-    void split_tree(ContextTreeNode * node) {
-        HyperCube * hypercube = node->hypercube;
-        if (hypercube->overflow(z1, z2) == false)
-            return;
-
-        if (context_tree_size >= 10000)
-            return;
-
-        // std::cout << "splitting" << std::endl;
-        // std::cout << *hypercube << std::endl;
-
-        std::string splitter;
-        init_splitter(splitter);
-
-        create_new_hypercube_in_tree(node, splitter);
-        context_tree_size += 1;
-
-        while (!splitter_exhausted(splitter)) {
-            create_new_hypercube_in_tree(node, splitter);
-            context_tree_size += 1;
-        }
-    }
-
-    void print_context_space(ContextTree tree) {
-        // print hypercubes in leaf of context_tree
-        std::cout << "context space" << std::endl;
-        if (tree == nullptr) {
-            std::cout << "Empty context tree" << std::endl;
-            return;
-        }
-
-        if (tree->child_nodes.empty() == false) {
-            for (auto & child : tree->child_nodes)
-                print_context_space(child);
-            return;
-        }
-
-        HyperCube * hypercube = tree->hypercube;
-        std::cout << *hypercube << std::endl;
-        return;
-    }
-
-    size_t size() {
-        return context_tree_size;
-    }
-
-    ContextTree get_context_tree() {
-        return context_tree;
-    }
-
-    size_t get_max_level() {
-        return max_level;
+        return HyperCube<D>(new_level, hypercube.get_capacity(),
+                            hypercube.get_sum_of_request(), new_bounds);
     }
 
 private:
@@ -523,118 +432,116 @@ private:
     size_t z2;
     size_t context_tree_size;
     size_t max_level;
+    size_t budget;
+    bool merging;
     std::vector<std::string> directions;
-    ContextTree context_tree;
+
+    // pool of nodes, blocks of children of merged nodes are reused
+    std::vector<Node> nodes;
+    std::vector<size_t> free_blocks;
+
+    // nodes with only leaf children by the time of the last learning in them
+    IndexedHeap<size_t, size_t> mergeable;
 };
 
 
-class Features {
-    typedef std::unordered_map<std::string, size_t> CidLongLong;
-public:
-    Features() {}
-    explicit Features(std::vector<std::string> time_features, 
-                const size_t & first_access, const CidLongLong & periods)
-    {
-        total_requests = 0;
+/*
+    Access statistics of a content in the windows of the time features.
+    The record is plain data, so the records of all contents are kept in
+    a dense array indexed by content id. A record with no requests is
+    a content which is not seen yet.
+*/
+template <size_t D>
+struct Features {
+    typedef std::array<size_t, D> Periods;
+
+    void start(const size_t & first_access) {
         this->first_access = first_access;
-        for (auto & feature : time_features) {
-            access_stat[feature] = 0;
-            starts[feature] = first_access;
-        }
+        total_requests = 0;
+        access_stat.fill(0);
+        starts.fill(first_access);
+    }
 
-        this->periods = periods;
+    bool seen() const {
+        return total_requests != 0;
     }
 
-    void update_features(const size_t & current_time) {
-        // std::cout << "update_features1" << std::endl;
+    // periods are the same for all contents
+    void update_features(const size_t & current_time, const Periods & periods) {
         total_requests += 1;
-        for (auto & element : access_stat) {
-            std::string feature = element.first;
-            // size_t count = element.second;
-            size_t start = starts[feature];
-            size_t period = periods[feature];
-            if ((start + period) <= current_time) {
-                // starts[feature] = period * (current_time / period);
-                starts[feature] = current_time;
-                access_stat[feature] = 0;
-                // std::cout << "update_features2" << std::endl;
-            } else {
-                access_stat[feature] += 1;
-                // std::cout << "update_features3" << std::endl;
-            }
+        for (size_t i = 0; i < D; ++i) {
+            // statistics of a passed period start again
+            bool expired = (starts[i] + periods[i]) <= current_time;
+            starts[i] = expired ? current_time : starts[i];
+            access_stat[i] = expired ? 0 : access_stat[i] + 1;
         }
-
     }
 
     bool popularity_revealed(const size_t & current_time, 
-                                const size_t & time_limit) 
+                                const size_t & time_limit) const
     {
         return (current_time - first_access) >= time_limit;
     }
 
-    size_t get_total_requests() {
+    size_t get_total_requests() const {
         return total_requests;
     }
 
-    ContextVector get_context_vector() {
-        ContextVector contextVector;
+    ContextVector<D> get_context_vector() const {
+        ContextVector<D> contextVector;
 
         size_t null = 0;
         double norm = 0;
 
-
-        for (auto & element : access_stat) {
-            if (element.second == 0)
-                ++null;
-            norm += element.second * element.second;
+        for (size_t i = 0; i < D; ++i) {
+            null += (access_stat[i] == 0);
+            norm += double(access_stat[i]) * double(access_stat[i]);
         }
 
         norm = pow(norm, 0.5);
 
-        if (norm <= EPS || null == access_stat.size())
+        if (norm <= EPS || null == D)
             norm = 1.0;
 
-        for (auto & element : access_stat) {
-            contextVector[element.first] = element.second / norm;
+        for (size_t i = 0; i < D; ++i) {
+            contextVector[i] = access_stat[i] / norm;
         }
 
         return contextVector;
     }
 
-
-private:
     // time of the first request
     size_t first_access;
 
-    // total count of the requests
-    size_t total_requests; 
-
-    //access statistics
-    CidLongLong access_stat; 
-
     // starts of period from access statistics
-    CidLongLong starts; 
+    std::array<size_t, D> starts;
+
+    // total count of the requests
+    uint32_t total_requests;
 
-    // periods for acccess_stat
-    CidLongLong periods;
+    // access statistics
+    std::array<uint32_t, D> access_stat;
 };
 
 
 
+// D is the count of time features, the first D of
+// 5 hours, 30 hours, 5 days and 10 days are used
+template <typename Key, typename Value, size_t D = 4>
 class PoPCaching {
-    typedef std::unordered_map<std::string, size_t> ContentSizes;
-    typedef std::unordered_map<std::string, size_t> CidLongLong;
-    typedef std::unordered_map<std::string, std::string> Cache;
+    static_assert(D >= 1 && D <= 4, "PoPCaching has from 1 to 4 time features");
+
+    typedef FlatHashMap<Key, Value> Cache;
 public:
     
     ~PoPCaching() {
         // std::cout << "~PoPCaching()" << std::endl;
-        // ContextTree contextTree = contextSpace->get_context_tree();
-        // contextSpace->print_context_space(contextTree);
+        // contextSpace->print_context_space();
         std::cout << "Max hypercube level -> " << contextSpace->get_max_level() << std::endl;
         std::cout << "Context space size -> " << contextSpace->size() << std::endl;
         if (contextSpace != nullptr)
             delete contextSpace;
+        delete workerPool;
     }
 
     PoPCaching() {};
@@ -651,27 +558,19 @@ public:
         z1 = Z1;
         z2 = Z2;
 
-        std::vector<std::string> time_features;
-        time_features.push_back("5 hours");
-        time_features.push_back("30 hours");
-        time_features.push_back("5 days");
-        time_features.push_back("10 days");
-
-        this->time_features = time_features;
-
-        CidLongLong periods;
-        periods["5 hours"] = 5 * HOUR;
-        periods["30 hours"] = 30 * HOUR;
-        periods["5 days"] = 5 * DAY;
-        periods["10 days"] = 10 * DAY;
+        const char * feature_names[] = {"5 hours", "30 hours", "5 days", "10 days"};
+        const size_t feature_periods[] = {5 * HOUR, 30 * HOUR, 5 * DAY, 10 * DAY};
 
-        this->periods = periods;
+        std::vector<std::string> time_features;
+        for (size_t i = 0; i < D; ++i) {
+            time_features.push_back(feature_names[i]);
+            periods[i] = feature_periods[i];
+        }
 
-        ContextSpace * contextSpace = new ContextSpace(time_features, z1, z2);
+        ContextSpace<D> * contextSpace = new ContextSpace<D>(time_features, z1, z2);
         std::cout << "initial context space" << std::endl;
         this->contextSpace = contextSpace;
-        ContextTree context_tree = contextSpace->get_context_tree();
-        this->contextSpace->print_context_space(context_tree);
+        this->contextSpace->print_context_space();
         std::cout << "cache was initialized" << std::endl;
     }
 
@@ -679,7 +578,7 @@ public:
         return;
     }
 
-    std::string * find(const std::string & cid, const size_t & current_time = 0) {
+    Value * find(const Key & cid, const size_t & current_time = 0) {
         ++cyclesCount;
         // std::cout << contextSpace->size() << std::endl;
 
@@ -705,14 +604,13 @@ public:
         // }
         // std::cout << std::endl;
 
-        if (content_features.find(cid) == content_features.end()) {
-            Features features = Features(time_features, current_time, periods);
-            content_features[cid] = features;
-        }
+        Features<D> & features = get_features(cid);
+        if (!features.seen())
+            features.start(current_time);
 
         // std::cout << "cache::find2" << std::endl;
 
-        content_features[cid].update_features(current_time);
+        features.update_features(current_time, periods);
 
         update_evaluations();
         learn_popularity(cid, current_time);
@@ -726,72 +624,50 @@ public:
         return &it->second;
     }
 
-    std::string * put(const std::string & cid, const std::string & value, const size_t & current_time = 0) {
+    Value * put(const Key & cid, const Value & value, const size_t & current_time = 0) {
         // std::cout << "cache::put1" << std::endl;
         // std::cout << "lookup.size() -> " << lookup.size() << std::endl;
         // std::cout << "estimations.size() -> " << estimations.size() << std::endl;
-        size_t cid_size = contentSizes[cid];
+        size_t cid_size = get_content_size(*contentSizes, cid);
         size_t popularity_estimation = estimate_popularity(cid);
 
         if (cid_size < cacheSize) {    
             // std::cout << "cache::put2" << std::endl;
             size_t sum_popularity = 0;
-            std::unordered_map<std::string, size_t> evicted_elements;
-
-            // evict old elements
-            while ((getCacheSize() + cid_size) > cacheSize) {
-                // std::cout << "cache::put3" << std::endl;
-                EstimationHolder least_popular = estimations.top();
-                std::string least_cid = least_popular.cid;
-                size_t least_estimation = least_popular.estimation;
-                evicted_elements[least_cid] = least_estimation;
-                sum_popularity += least_estimation;
-
-                if (estimations.remove(least_popular) == false) {
-                   std::cout << "Error in removing holder from queue 1" << std::endl;
-                   exit(127);
-                }
-                
-                currentCacheSize -= contentSizes[least_cid];
-                cidEstimationHolderMap.erase(least_cid); 
-                size_t s1 = lookup.size();
-                lookup.erase(least_cid);
-                size_t s2 = lookup.size();
-                if (++s2 != s1)
-                    std::cout << "ERROR. lookup.erase " << std::endl;
-            }
-
-            // compare sum popularity with popularity of the new content
+            size_t freed_size = 0;
+
+            // choose the least popular elements to free space
+            // without evicting them yet
+            victims.clear();
+            estimations.preview([&](const Key & victim, const size_t & estimation) {
+                if ((getCacheSize() - freed_size + cid_size) <= cacheSize)
+                    return false;
+
+                victims.push_back(victim);
+                sum_popularity += estimation;
+                freed_size += get_content_size(*contentSizes, victim);
+                return true;
+            });
+
+            // compare sum popularity with popularity of the new content,
+            // if it is not sufficient then the cache stays as it is
             size_t compare_coeff = 2;
             if (popularity_estimation >= compare_coeff * sum_popularity) {   
-                EstimationHolder new_holder = EstimationHolder(cid, 
-                                                popularity_estimation);
+                for (auto & victim : victims) {
+                    estimations.erase(victim);
+                    currentCacheSize -= get_content_size(*contentSizes, victim);
+                    if (lookup.erase(victim) == 0)
+                        std::cout << "ERROR. lookup.erase " << std::endl;
+                }
 
-                estimations.push(new_holder);
-                currentCacheSize += contentSizes[cid];
-                cidEstimationHolderMap[cid] = new_holder;
-                std::pair<std::string, std::string> pair = std::make_pair(cid, cid);
+                estimations.push(cid, popularity_estimation);
+                currentCacheSize += get_content_size(*contentSizes, cid);
+                std::pair<Key, Value> pair = std::make_pair(cid, value);
                 lookup.insert(pair);
                 // std::cout << "cache::put4" << std::endl;
                 // std::cout << "lookup.size() -> " << lookup.size() << std::endl;
                 return &(lookup.find(cid)->second);
             } 
-
-            // if popularity of the new content is not sufficient 
-            // then return to previous state
-            for (auto & element : evicted_elements) {
-                std::string element_cid = element.first;
-                size_t estimation = element.second;
-                EstimationHolder holder = EstimationHolder(element_cid, estimation);
-                estimations.push(holder);
-                currentCacheSize += contentSizes[element_cid];
-                cidEstimationHolderMap[element_cid] = holder;
-
-                std::pair<std::string, std::string> pair = 
-                            std::make_pair(element_cid, element_cid);
-
-                lookup.insert(pair);
-            }
             // std::cout << "cache::put5" << std::endl;
         }
 
@@ -802,23 +678,27 @@ public:
         return lookup.size();
     }
 
-    ContentSizes getContentSizes() {
-        return contentSizes;
+    const ContentSizes & getContentSizes() const {
+        return *contentSizes;
     }
 
     size_t getCacheSize() {
         return currentCacheSize;
     }
 
-    void addCidSize(std::string cid, size_t size) {
-        ContentSizes::iterator it = contentSizes.find(cid);
-        if (it != contentSizes.end() && it->second != size) {
-            std::cout << "Another size for content. Was -> " <<  it->second
-                << " now -> "<< size 
-                << " for cid -> " << cid << std::endl;
-        }
+    void setContentSizes(const ContentSizes *sizes) {
+        contentSizes = sizes;
+    }
+
+    // maximal count of hypercubes in the context space
+    void setContextSpaceBudget(const size_t & budget) {
+        contextSpace->set_budget(budget);
+    }
 
-        contentSizes[cid] = size;
+    // threads of re-estimation of cached contents
+    void setEstimationThreads(const size_t & threads) {
+        delete workerPool;
+        workerPool = threads > 1 ? new WorkerPool(threads) : nullptr;
     }
 
     void update_evaluations() {
@@ -826,29 +706,26 @@ public:
             return;
 
         // Re-estimate the request rate for all content in 'estimations'
-        // Rebuild the priority queue 'estimations'
-
-        // std::cout << "update_evaluations" << std::endl;
-
-        for (auto & element : lookup) {
-            auto & cid = element.first;
-            EstimationHolder old_holder = cidEstimationHolderMap[cid];
-            if (estimations.remove(old_holder) == false) {
-                std::cout << "Error in removing holder from queue 2" << std::endl;
-                exit(127);
-            }
-
-            size_t new_estimation = estimate_popularity(cid);
-            EstimationHolder new_holder = EstimationHolder(cid, new_estimation);
-            cidEstimationHolderMap[cid] = new_holder;
-            estimations.push(new_holder);
+        // and rebuild the queue 'estimations' at once
+        auto estimate = [this](const Key & cid) {
+            return estimate_popularity(cid);
+        };
+
+        // estimations only read the context space and features
+        if (workerPool != nullptr && estimations.size() >= PARALLEL_ESTIMATIONS) {
+            estimations.update_all(estimate, [this](const size_t & count,
+                                                   const std::function<void(size_t, size_t)> & task) {
+                workerPool->for_each_range(count, task);
+            });
+        } else {
+            estimations.update_all(estimate);
         }
     }
 
-    void learn_popularity(const std::string & cid,
+    void learn_popularity(const Key & cid,
                             const size_t & current_time)
     {
-        Features features = content_features[cid];
+        Features<D> & features = get_features(cid);
         if (features.popularity_revealed(current_time, learn_limit) == false) 
             return;
 
@@ -856,43 +733,36 @@ public:
 
         // NOTE: learn must call only one time or many time if time >= learn_limit
 
-        ContextVector context_vector = features.get_context_vector();
-        ContextTree context_tree = contextSpace->get_context_tree();
-        ContextTree node = contextSpace->find_hypercube_in_tree(context_tree, context_vector);
+        ContextVector<D> context_vector = features.get_context_vector();
+        size_t node = contextSpace->find_hypercube(context_vector);
 
-        if (node == nullptr) {
+        if (node == ContextSpace<D>::NOT_FOUND) {
             std::cout << "In learn popularity. node == nullptr" << std::endl;
             exit(127);
         }
         
-        HyperCube * hypercube = node->hypercube;
-        size_t total_requests = features.get_total_requests();
-        hypercube->add_capacity(1);
-        hypercube->add_sum_of_requests(total_requests);
-        contextSpace->split_tree(node);
+        contextSpace->learn(node, features.get_total_requests(), current_time);
     }
 
-    size_t estimate_popularity(const std::string & cid) {
-        Features features = content_features[cid];
-        ContextVector context_vector = features.get_context_vector();
-        ContextTree context_tree = contextSpace->get_context_tree();
-        ContextTree node = contextSpace->find_hypercube_in_tree(context_tree, context_vector);
+    size_t estimate_popularity(const Key & cid) const {
+        const Features<D> & features = read_features(cid);
+        ContextVector<D> context_vector = features.get_context_vector();
+        size_t node = contextSpace->find_hypercube(context_vector);
 
-        if (node == nullptr) {
+        if (node == ContextSpace<D>::NOT_FOUND) {
             print_context_vector(context_vector);
             std::cout << "In learn popularity. node == nullptr" << std::endl;
             exit(127);
         }
 
-        HyperCube * hypercube = node->hypercube;
-        size_t estimation = hypercube->get_estimation();
+        size_t estimation = contextSpace->get_hypercube(node).get_estimation();
 
         // std::cout << "estimation -> " << estimation << std::endl;
         return estimation;
     }
 
-    VecStr get_hot_content(const float &cache_hot_content) {
-        return VecStr();
+    std::vector<Key> get_hot_content(const float &cache_hot_content) {
+        return std::vector<Key>();
     }
 
     size_t size() {
@@ -900,6 +770,21 @@ public:
     }
 
 private:
+    // content ids are dense, the array grows to the largest one
+    Features<D> & get_features(const Key & cid) {
+        if (size_t(cid) >= content_features.size())
+            content_features.resize(size_t(cid) + 1);
+        return content_features[cid];
+    }
+
+    const Features<D> & read_features(const Key & cid) const {
+        static const Features<D> unseen = Features<D>();
+        if (size_t(cid) >= content_features.size())
+            return unseen;
+        return content_features[cid];
+    }
+
+
     size_t cacheSize;
     size_t currentCacheSize;
     size_t cyclesCount;
@@ -910,47 +795,25 @@ private:
     size_t z1;
     size_t z2;
 
-    std::vector<std::string> time_features;
-    CidLongLong periods;
+    // periods of access statistics of the time features
+    typename Features<D>::Periods periods;
 
-    ContentSizes contentSizes;
-    ContextSpace * contextSpace;
+    const ContentSizes *contentSizes = nullptr;
+    ContextSpace<D> * contextSpace;
     
     // keep cid -> and value
     Cache lookup;
 
-    std::unordered_map<std::string, Features> content_features;
-
-    struct EstimationHolder {
-        std::string cid;
-        size_t estimation;
-        EstimationHolder(){}
-        EstimationHolder(const std::string & cid, const size_t & estimation) : 
-            cid(cid),
-            estimation(estimation) {}
-
-        bool operator < (const EstimationHolder & other) const {
-            return estimation > other.estimation;
-        }
+    // features of contents seen, indexed by content id
+    std::vector<Features<D>> content_features;
 
-        bool operator == (const EstimationHolder & other) const {
-            return (cid == other.cid) && (estimation == other.estimation);
-        }
-
-        friend std::ostream & operator << (std::ostream & out, 
-            const EstimationHolder & holder)
-        {
-            out << "cid -> " << holder.cid << ' ' 
-                << "estimation -> " << holder.estimation;
-            return out;
-        }
-
-    };
+    // estimations for cids in cache, the least popular cid on top
+    IndexedHeap<Key, size_t> estimations;
 
-    // estimations for cids in cache
-    custom_priority_queue<EstimationHolder> estimations;
+    // elements to be evicted for the content in put
+    std::vector<Key> victims;
 
-    // map between cid and its EstimationHolder
-    // This map is needed for removing elements from queue estimations
-    std::unordered_map<std::string, EstimationHolder> cidEstimationHolderMap;
+    // smaller caches are re-estimated on the simulation thread
+    static const size_t PARALLEL_ESTIMATIONS = 4096;
+    WorkerPool * workerPool = nullptr;
 };
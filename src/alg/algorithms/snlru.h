@@ -13,7 +13,6 @@
 
 template <typename Key, typename Value>
 class SNLRUCache {
-    typedef std::unordered_map<std::string, size_t> ContentSizes;
     typedef std::unordered_map<std::string, size_t> CandidateList;
 public:
     SNLRUCache() {};
@@ -118,8 +117,8 @@ public:
         lruList.front().setEvictionCallback(callback);
     }
 
-    ContentSizes getContentSizes() {
-        return contentSizes;
+    const ContentSizes & getContentSizes() const {
+        return *contentSizes;
     }
 
     size_t getCacheSize() {
@@ -130,33 +129,19 @@ public:
         return currentCacheSize;
     }
 
-    void addCidSize(std::string cid, size_t size) {
-        ContentSizes::iterator it = contentSizes.find(cid);
-        if (it != contentSizes.end() && it->second != size) {
-            std::cout << "Another size for content. Was -> " <<  it->second
-                << " now -> "<< size 
-                << " for cid -> " << cid << std::endl;
-        }
-
-        contentSizes[cid] = size;
+    void setContentSizes(const ContentSizes *sizes) {
+        contentSizes = sizes;
 
         for (auto & lruCache : lruList) {
-            lruCache.addCidSize(cid, size);
+            lruCache.setContentSizes(sizes);
         }
-
     }
 
-    VecStr get_hot_content(const float &cache_hot_content) {
-        VecStr hot_content;
-        int curr_count = 0;
-        int count = MAX((int)(cache_hot_content*elementsCount()), 1);
-        for (int i = (lruList.size()-1); i >= 0 && curr_count < count; --i) {
-            auto &lru_cache = lruList[i];
-            typename std::list<std::pair<Key, Value>>::reverse_iterator it = 
-                                                lru_cache.lruList.rbegin();
-            for (; it != lru_cache.lruList.rend() && curr_count++ < count; ++it) {
-                hot_content.push_back(it->first);
-            }
+    std::vector<Key> get_hot_content(const float &cache_hot_content) {
+        std::vector<Key> hot_content;
+        size_t count = MAX((int)(cache_hot_content*elementsCount()), 1);
+        for (int i = (lruList.size()-1); i >= 0 && hot_content.size() < count; --i) {
+            lruList[i].appendRecent(hot_content, count);
         }
         return hot_content;
     }
@@ -185,7 +170,7 @@ private:
 
     std::vector<LRUCache<Key, Value>> lruList;
 
-    ContentSizes contentSizes;
+    const ContentSizes *contentSizes = nullptr;
 
     // CandidateList candidateList;
 };
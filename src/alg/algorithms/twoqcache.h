@@ -9,7 +9,6 @@
 
 template <typename Key, typename Value>
 class TwoQCache {
-    typedef std::unordered_map<std::string, size_t> ContentSizes;
 public:
     TwoQCache () {};
     explicit TwoQCache(size_t size, const size_t & learn_limit = 100, const size_t & period = 1000, 
@@ -91,8 +90,8 @@ public:
         mainCache.setEvictionCallback(callback);
     }
 
-    ContentSizes getContentSizes() {
-        return contentSizes;
+    const ContentSizes & getContentSizes() const {
+        return *contentSizes;
     }
 
     size_t getCacheSize() {
@@ -104,23 +103,16 @@ public:
         return currentCacheSize;
     }
 
-    void addCidSize(std::string cid, size_t size) {
-        ContentSizes::iterator it = contentSizes.find(cid);
-        if (it != contentSizes.end() && it->second != size) {
-            std::cout << "Another size for content. Was -> " <<  it->second
-                << " now -> "<< size 
-                << " for cid -> " << cid << std::endl;
-        }
-
-        contentSizes[cid] = size;
+    void setContentSizes(const ContentSizes *sizes) {
+        contentSizes = sizes;
 
-        aIn.addCidSize(cid, size);
-        aOut.addCidSize(cid, size);
-        mainCache.addCidSize(cid, size);
+        aIn.setContentSizes(sizes);
+        aOut.setContentSizes(sizes);
+        mainCache.setContentSizes(sizes);
     }
 
-    VecStr get_hot_content(const float &cache_hot_content) {
-        return VecStr();
+    std::vector<Key> get_hot_content(const float &cache_hot_content) {
+        return std::vector<Key>();
     }
 
 private:
@@ -133,5 +125,5 @@ private:
 
     std::function<void(const Key &,const Value &)> evictionCallback;
 
-    ContentSizes contentSizes;
+    const ContentSizes *contentSizes = nullptr;
 };
@@ -34,6 +34,10 @@ Config::Config(const std::string &filename) {
 	input.close();
 }
 
+bool Config::contains(const std::string &name) const {
+	return config_map.find(name) != config_map.end();
+}
+
 int Config::get_int_by_name(const std::string &name) {
 	auto it = config_map.find(name);
 	if (it == config_map.end()) {
@@ -9,6 +9,7 @@ class Config {
 	typedef std::unordered_map<std::string, std::string> ConfigMap;
 public:
 	Config(const std::string &filename);
+	bool contains(const std::string &name) const;
 	int get_int_by_name(const std::string &name);
 	float get_float_by_name(const std::string &name);
 	std::string get_str_by_name(const std::string &name);
@@ -17,7 +17,7 @@ void HistoryManager::start_new_period() {
 		hist.second.push_back(0);
 }
 
-void HistoryManager::update_object_history(std::string &object_id, 
+void HistoryManager::update_object_history(const ContentId &object_id, 
 											const int &current_period) {
 	auto it = objects_history.find(object_id);
 	if (it == objects_history.end()) {
@@ -27,7 +27,7 @@ void HistoryManager::update_object_history(std::string &object_id,
 }
 
 std::vector<int>
-HistoryManager::get_object_history(std::string &object_id) {
+HistoryManager::get_object_history(const ContentId &object_id) {
 	auto it = objects_history.find(object_id);
 	if (it == objects_history.end()) {
 		return std::vector<int>();
@@ -35,7 +35,7 @@ HistoryManager::get_object_history(std::string &object_id) {
 	return objects_history[object_id];
 }
 
-std::vector<std::string> 
+VecContentId 
 HistoryManager::get_hot_objects(const int &window, const float &rate) {
 	/*
 	1. fetch summary requests of the last window for each objects
@@ -43,8 +43,8 @@ HistoryManager::get_hot_objects(const int &window, const float &rate) {
 	3. return only rate of whole objects
 	*/ 
 
-	std::vector<std::string> objects(objects_history.size());
-	std::unordered_map<std::string, int> window_history;
+	VecContentId objects(objects_history.size());
+	std::unordered_map<ContentId, int> window_history;
 	int i = 0;
 	int sum;
 	for (auto &hist : objects_history) {
@@ -55,14 +55,17 @@ HistoryManager::get_hot_objects(const int &window, const float &rate) {
 		window_history[hist.first] = sum;
 	}
 
-	stable_sort(objects.begin(), objects.end(),
-		[&window_history] (const std::string &first, const std::string &second){
-			return window_history[first] > window_history[second];
+	/* ties are broken by id, i.e. by the order of the first request */
+	sort(objects.begin(), objects.end(),
+		[&window_history] (const ContentId &first, const ContentId &second){
+			int first_sum = window_history[first];
+			int second_sum = window_history[second];
+			return first_sum > second_sum || (first_sum == second_sum && first < second);
 		}
 	);
 
 	int count = MAX((int)(rate*objects_history.size()), 1);
-	std::vector<std::string> result(count);
+	VecContentId result(count);
 	for (unsigned int i = 0; i < result.size(); ++i) {
 		result[i] = objects[i];
 	}
@@ -71,13 +74,13 @@ HistoryManager::get_hot_objects(const int &window, const float &rate) {
 }
 
 float HistoryManager::get_average_size_in_window(const int &window, 
-										ContentSizes & content_sizes,
+										const ContentSizes & content_sizes,
 										const int &type) {
 	size_t count    = 0;
 	size_t sum_size = 0;
 	std::vector<size_t> sizes;
 	for (auto &hist : objects_history) {
-		size_t object_size = content_sizes[hist.first];
+		size_t object_size = get_content_size(content_sizes, hist.first);
 		for (int i = 0; i < MIN(window, (int)hist.second.size()); ++i) {
 			if (hist.second[hist.second.size()-i-1] != 0) {
 				++count;
@@ -5,57 +5,70 @@
 #include <unordered_set>
 
 
-PrePush::PrePush(Config &config) {
-	read_mother_child(config.get_str_by_name("PRE_PUSH_MOTHER_CHILD"));
-	read_child_mother(config.get_str_by_name("PRE_PUSH_CHILD_MOTHER"));
+PrePush::PrePush(Config &config, ContentInterner &interner) {
+	read_mother_child(config.get_str_by_name("PRE_PUSH_MOTHER_CHILD"), interner);
+	read_child_mother(config.get_str_by_name("PRE_PUSH_CHILD_MOTHER"), interner);
 	window 			 = config.get_int_by_name("PRE_PUSH_HISTORY_WINDOW");
 	hist_hot_objects = config.get_float_by_name("PRE_PUSH_HISTORY_HOT_CONTENT");
 }
 
-VecStr PrePush::get_pre_push_list(VecStr &cache_hot_objects, 
+VecContentId PrePush::get_pre_push_list(VecContentId &cache_hot_objects, 
 							      HistoryManager &history_manager) {
-	std::unordered_set<std::string> result;
-	VecStr history_hot_objects = history_manager.get_hot_objects(window,
+	std::unordered_set<ContentId> result;
+	VecContentId history_hot_objects = history_manager.get_hot_objects(window,
 													hist_hot_objects);
 	/* find objects whose are in mother-child relationship */
 	/* history hot objects */
-	for (auto &object : history_hot_objects) {
-		std::string mother_id = child_mother[object];
-		result.insert(	mother_child[mother_id].begin(), 
-						mother_child[mother_id].end());
-	}
+	for (auto &object : history_hot_objects)
+		add_children(object, result);
 
 	/* cache hot objects */
-	for (auto &object : cache_hot_objects) {
-		std::string mother_id = child_mother[object];
-
-		result.insert(	mother_child[mother_id].begin(),
-						mother_child[mother_id].end());
-	}
+	for (auto &object : cache_hot_objects)
+		add_children(object, result);
 
 	/* add history hot objects */
 	result.insert(	history_hot_objects.begin(),
 					history_hot_objects.end());
 
-	return VecStr(result.begin(), result.end());
+	return VecContentId(result.begin(), result.end());
+}
+
+void PrePush::add_children(const ContentId &object, 
+						   std::unordered_set<ContentId> &result) {
+	auto mother = child_mother.find(object);
+	if (mother == child_mother.end())
+		return;
+
+	auto children = mother_child.find(mother->second);
+	if (children == mother_child.end())
+		return;
+
+	result.insert(	children->second.begin(),
+					children->second.end());
 }
 
-void PrePush::read_mother_child(const std::string &mother_child_file) {
+void PrePush::read_mother_child(const std::string &mother_child_file,
+								ContentInterner &interner) {
 	std::fstream input(mother_child_file);
 	std::string mother_id;
+	std::string child_id;
 	int mother_count = 0;
 	int child_count = 0;
 	input >> mother_count;
 	for(int i = 0; i < mother_count; ++i) {	
 		input >> mother_id >> child_count;
-		mother_child[mother_id] = VecStr(child_count);
-		for (int j = 0; j < child_count; ++j)
-			input >> mother_child[mother_id][j];
+		VecContentId &children = mother_child[interner.intern(mother_id)];
+		children = VecContentId(child_count);
+		for (int j = 0; j < child_count; ++j) {
+			input >> child_id;
+			children[j] = interner.intern(child_id);
+		}
 	}
 	input.close();
 }
 
-void PrePush::read_child_mother(const std::string &child_mother_file) {
+void PrePush::read_child_mother(const std::string &child_mother_file,
+								ContentInterner &interner) {
 	std::fstream input(child_mother_file);
 	std::string child_id;
 	std::string mother_id;
@@ -63,7 +76,7 @@ void PrePush::read_child_mother(const std::string &child_mother_file) {
 	input >> child_count;
 	for (int i = 0; i < child_count; ++i) {
 		input >> child_id >> mother_id;
-		child_mother[child_id] = mother_id;
+		child_mother[interner.intern(child_id)] = interner.intern(mother_id);
 	}
 	input.close();
 }
@@ -3,16 +3,19 @@
 #include "defs.h"
 #include "config.h"
 #include "history_manager.h"
+#include "content_interner.h"
+
+#include <unordered_set>
 
 
 class PrePush {
-	typedef std::unordered_map<std::string, VecStr> MotherChildMap;
-	typedef std::unordered_map<std::string, std::string> ChildMotherMap;
+	typedef std::unordered_map<ContentId, VecContentId> MotherChildMap;
+	typedef std::unordered_map<ContentId, ContentId> ChildMotherMap;
 public:
-	PrePush(Config &config);
-	VecStr get_pre_push_list(VecStr &cache_hot_objects, HistoryManager &history_manager);
-	void read_mother_child(const std::string &mother_child_file);
-	void read_child_mother(const std::string &child_mother_file);
+	PrePush(Config &config, ContentInterner &interner);
+	VecContentId get_pre_push_list(VecContentId &cache_hot_objects, HistoryManager &history_manager);
+	void read_mother_child(const std::string &mother_child_file, ContentInterner &interner);
+	void read_child_mother(const std::string &child_mother_file, ContentInterner &interner);
 	void print_mother_child();
 	void print_child_mother();
 private:
@@ -20,4 +23,6 @@ private:
 	float hist_hot_objects;
 	MotherChildMap mother_child;
 	ChildMotherMap child_mother;
+
+	void add_children(const ContentId &object, std::unordered_set<ContentId> &result);
 };
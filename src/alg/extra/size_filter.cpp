@@ -15,7 +15,7 @@ SizeFilter::SizeFilter(Config & config) {
 	threshold = config.get_float_by_name("SIZE_FILTER_INITIAL_TRESHOLD");
 }
 
-bool SizeFilter::admit_object(	std::string &id, const float &size, 
+bool SizeFilter::admit_object(	const ContentId &id, const float &size, 
 								HistoryManager &history_manager) {
 	
 	if (enable == false) return true;
@@ -32,7 +32,7 @@ bool SizeFilter::admit_object(	std::string &id, const float &size,
 }
 
 void SizeFilter::update_threshold(HistoryManager &history_manager, 
-									ContentSizes & content_sizes) {
+									const ContentSizes & content_sizes) {
 	/* update threshold */
 	threshold = enable ? history_manager.get_average_size_in_window
 							(window, content_sizes, type) : threshold;
@@ -9,8 +9,8 @@ class SizeFilter {
 public:
 	SizeFilter() {};
 	SizeFilter(Config &);
-	bool admit_object(std::string &id, const float &size, HistoryManager &history_manager);
-	void update_threshold(HistoryManager &history_manager, ContentSizes &content_sizes);
+	bool admit_object(const ContentId &id, const float &size, HistoryManager &history_manager);
+	void update_threshold(HistoryManager &history_manager, const ContentSizes &content_sizes);
 	float get_threshold();
 private:
 	int type;
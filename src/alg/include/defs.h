@@ -1,14 +1,66 @@
 #pragma once 
 
 #include <stdio.h>
+#include <string>
 #include <vector>
+#include <cstdint>
 #include <unordered_map>
 
+/* dense identifier of a content, assigned by ContentInterner */
+typedef uint32_t ContentId;
+
 typedef std::vector<int> VecInt;
 typedef std::vector<long long> VecLLInt;
 typedef std::vector<std::string> VecStr;
-typedef std::unordered_map<std::string, VecInt> ObjectsHistory;
+typedef std::vector<ContentId> VecContentId;
+typedef std::unordered_map<ContentId, VecInt> ObjectsHistory;
 typedef std::unordered_map<std::string, std::string> ConfigMap;
-typedef std::unordered_map<std::string, VecStr> MotherChildMap;
-typedef std::unordered_map<std::string, std::string> ChildMotherMap;
-typedef std::unordered_map<std::string, size_t> ContentSizes;
+typedef std::unordered_map<ContentId, VecContentId> MotherChildMap;
+typedef std::unordered_map<ContentId, ContentId> ChildMotherMap;
+
+
+/*
+    sizes of contents indexed by ContentId, one table is shared by all caches;
+    every size is stored with the position of the first request of the content
+*/
+class ContentSizes {
+public:
+    bool contains(const ContentId &cid) const {
+        return cid < sizes.size() && sizes[cid] != UNKNOWN_SIZE;
+    }
+
+    /* content was requested at or before the position of the trace */
+    bool requested_by(const ContentId &cid, const size_t &position) const {
+        return contains(cid) && first_requests[cid] <= position;
+    }
+
+    size_t get(const ContentId &cid) const {
+        return contains(cid) ? sizes[cid] : 0;
+    }
+
+    void set(const ContentId &cid, const size_t &size, const size_t &first_request = 0) {
+        if (cid >= sizes.size()) {
+            sizes.resize(cid + 1, size_t(UNKNOWN_SIZE));
+            first_requests.resize(cid + 1, 0);
+        }
+        sizes[cid] = size;
+        first_requests[cid] = first_request;
+    }
+
+    void reserve(const size_t &count) {
+        sizes.reserve(count);
+        first_requests.reserve(count);
+    }
+
+private:
+    static const size_t UNKNOWN_SIZE = SIZE_MAX;
+
+    std::vector<size_t> sizes;
+    std::vector<size_t> first_requests;
+};
+
+
+/* size of the content or 0 if the content was not requested yet */
+inline size_t get_content_size(const ContentSizes &content_sizes, const ContentId &cid) {
+    return content_sizes.get(cid);
+}
@@ -0,0 +1,325 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+#include <iterator>
+#include <functional>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+/*
+    Open addressing hash map for the lookup tables of the policies.
+
+    Slots are split into groups of 16 with one control byte per slot:
+    EMPTY, DELETED or 7 bits of the hash of the key in the slot. A lookup
+    compares the control bytes of a whole group with one SSE2 instruction
+    and touches a slot only when its tag matches, so a probe reads one
+    cache line of control bytes instead of walking a chain of nodes.
+
+    Unlike std::unordered_map, references and iterators are invalidated
+    by insertions, and the iteration order is the order of slots.
+*/
+template <typename Key, typename T, typename Hash = std::hash<Key>>
+class FlatHashMap {
+public:
+    typedef std::pair<Key, T> value_type;
+
+    template <typename Map, typename Value>
+    class Iterator : public std::iterator<std::forward_iterator_tag, Value> {
+    public:
+        Iterator() : map(nullptr), index(0) {}
+        Iterator(Map *map, const size_t &index) : map(map), index(index) {
+            skip();
+        }
+
+        // iterator converts to const_iterator
+        template <typename OtherMap, typename OtherValue>
+        Iterator(const Iterator<OtherMap, OtherValue> &other) :
+            map(other.map), index(other.index) {}
+
+        Value & operator * () const {
+            return map->slots[index];
+        }
+
+        Value * operator -> () const {
+            return &map->slots[index];
+        }
+
+        Iterator & operator ++ () {
+            ++index;
+            skip();
+            return *this;
+        }
+
+        Iterator operator ++ (int) {
+            Iterator result = *this;
+            ++(*this);
+            return result;
+        }
+
+        bool operator == (const Iterator &other) const {
+            return index == other.index;
+        }
+
+        bool operator != (const Iterator &other) const {
+            return index != other.index;
+        }
+
+    private:
+        template <typename, typename> friend class Iterator;
+        friend class FlatHashMap;
+
+        void skip() {
+            while (index < map->control.size() && !is_full(map->control[index]))
+                ++index;
+        }
+
+        Map *map;
+        size_t index;
+    };
+
+    typedef Iterator<FlatHashMap, value_type> iterator;
+    typedef Iterator<const FlatHashMap, const value_type> const_iterator;
+
+    FlatHashMap() :
+        size_(0),
+        deleted(0) {}
+
+    iterator begin() {
+        return iterator(this, 0);
+    }
+
+    iterator end() {
+        return iterator(this, control.size());
+    }
+
+    const_iterator begin() const {
+        return const_iterator(this, 0);
+    }
+
+    const_iterator end() const {
+        return const_iterator(this, control.size());
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    void clear() {
+        control.clear();
+        slots.clear();
+        size_ = 0;
+        deleted = 0;
+    }
+
+    void reserve(const size_t &count) {
+        size_t capacity = GROUP_SIZE;
+        while (capacity * MAX_LOAD_NUM / MAX_LOAD_DEN < count)
+            capacity *= 2;
+        if (capacity > control.size())
+            rehash(capacity);
+    }
+
+    iterator find(const Key &key) {
+        return iterator(this, find_index(key));
+    }
+
+    const_iterator find(const Key &key) const {
+        return const_iterator(this, find_index(key));
+    }
+
+    size_t count(const Key &key) const {
+        return find_index(key) != control.size() ? 1 : 0;
+    }
+
+    T & operator [] (const Key &key) {
+        return slots[insert_index(key).first].second;
+    }
+
+    std::pair<iterator, bool> insert(const value_type &value) {
+        std::pair<size_t, bool> result = insert_index(value.first);
+        if (result.second)
+            slots[result.first].second = value.second;
+        return std::make_pair(iterator(this, result.first), result.second);
+    }
+
+    size_t erase(const Key &key) {
+        size_t index = find_index(key);
+        if (index == control.size())
+            return 0;
+        erase_index(index);
+        return 1;
+    }
+
+    void erase(const_iterator it) {
+        erase_index(it.index);
+    }
+
+private:
+    static const size_t GROUP_SIZE = 16;
+    static const int8_t EMPTY = -128;
+    static const int8_t DELETED = -2;
+
+    // rehash when 7/8 of slots are used
+    static const size_t MAX_LOAD_NUM = 7;
+    static const size_t MAX_LOAD_DEN = 8;
+
+    static bool is_full(const int8_t &control) {
+        return control >= 0;
+    }
+
+    // std::hash of integers is the identity, mix all bits into the hash
+    static uint64_t hash(const Key &key) {
+        uint64_t h = Hash()(key);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    static int8_t tag(const uint64_t &h) {
+        return static_cast<int8_t>(h & 0x7f);
+    }
+
+    size_t groups_count() const {
+        return control.size() / GROUP_SIZE;
+    }
+
+    // bit i is set if control byte i of the group equals value
+    uint32_t match(const size_t &group, const int8_t value) const {
+        const int8_t *bytes = &control[group * GROUP_SIZE];
+#ifdef __SSE2__
+        __m128i ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes));
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(value))));
+#else
+        uint32_t mask = 0;
+        for (size_t i = 0; i < GROUP_SIZE; ++i)
+            mask |= static_cast<uint32_t>(bytes[i] == value) << i;
+        return mask;
+#endif
+    }
+
+    // bit i is set if slot i of the group is empty or deleted
+    uint32_t match_free(const size_t &group) const {
+        const int8_t *bytes = &control[group * GROUP_SIZE];
+#ifdef __SSE2__
+        __m128i ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes));
+        return static_cast<uint32_t>(_mm_movemask_epi8(ctrl));
+#else
+        uint32_t mask = 0;
+        for (size_t i = 0; i < GROUP_SIZE; ++i)
+            mask |= static_cast<uint32_t>(!is_full(bytes[i])) << i;
+        return mask;
+#endif
+    }
+
+    static size_t lowest_bit(const uint32_t &mask) {
+        return static_cast<size_t>(__builtin_ctz(mask));
+    }
+
+    size_t find_index(const Key &key) const {
+        if (size_ == 0)
+            return control.size();
+
+        uint64_t h = hash(key);
+        size_t mask = groups_count() - 1;
+        size_t group = (h >> 7) & mask;
+
+        // triangular probing visits every group once
+        for (size_t step = 1; step <= groups_count(); ++step) {
+            for (uint32_t bits = match(group, tag(h)); bits != 0; bits &= bits - 1) {
+                size_t index = group * GROUP_SIZE + lowest_bit(bits);
+                if (slots[index].first == key)
+                    return index;
+            }
+            if (match(group, EMPTY) != 0)
+                break;
+            group = (group + step) & mask;
+        }
+        return control.size();
+    }
+
+    // index of the key, inserted with a default value if it is absent
+    std::pair<size_t, bool> insert_index(const Key &key) {
+        size_t index = find_index(key);
+        if (index != control.size())
+            return std::make_pair(index, false);
+
+        if ((size_ + deleted + 1) > control.size() * MAX_LOAD_NUM / MAX_LOAD_DEN) {
+            // drop tombstones in place if they take a big part of the table
+            size_t capacity = control.size();
+            if (capacity == 0)
+                capacity = GROUP_SIZE;
+            else if (size_ * 2 >= capacity * MAX_LOAD_NUM / MAX_LOAD_DEN)
+                capacity *= 2;
+            rehash(capacity);
+        }
+
+        uint64_t h = hash(key);
+        index = free_index(h);
+        if (control[index] == DELETED)
+            --deleted;
+        control[index] = tag(h);
+        slots[index] = value_type(key, T());
+        ++size_;
+        return std::make_pair(index, true);
+    }
+
+    size_t free_index(const uint64_t &h) const {
+        size_t mask = groups_count() - 1;
+        size_t group = (h >> 7) & mask;
+        for (size_t step = 1; ; ++step) {
+            uint32_t bits = match_free(group);
+            if (bits != 0)
+                return group * GROUP_SIZE + lowest_bit(bits);
+            group = (group + step) & mask;
+        }
+    }
+
+    void erase_index(const size_t &index) {
+        // a group which still has an empty slot never stopped a probe,
+        // so the slot may become empty instead of a tombstone
+        if (match(index / GROUP_SIZE, EMPTY) != 0) {
+            control[index] = EMPTY;
+        } else {
+            control[index] = DELETED;
+            ++deleted;
+        }
+        slots[index] = value_type();
+        --size_;
+    }
+
+    void rehash(const size_t &capacity) {
+        std::vector<int8_t> old_control(capacity, int8_t(EMPTY));
+        std::vector<value_type> old_slots(capacity);
+        old_control.swap(control);
+        old_slots.swap(slots);
+        deleted = 0;
+
+        for (size_t i = 0; i < old_control.size(); ++i) {
+            if (!is_full(old_control[i]))
+                continue;
+            uint64_t h = hash(old_slots[i].first);
+            size_t index = free_index(h);
+            control[index] = tag(h);
+            slots[index] = std::move(old_slots[i]);
+        }
+    }
+
+private:
+    std::vector<int8_t> control;
+    std::vector<value_type> slots;
+    size_t size_;
+    size_t deleted;
+};
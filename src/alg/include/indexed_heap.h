@@ -0,0 +1,190 @@
+#pragma once
+
+#include "flat_hash_map.h"
+
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+#include <utility>
+#include <functional>
+
+
+/*
+    Binary min-heap of keys with the position of every key in a hash map,
+    so the priority of a key is changed and a key is removed in O(log n)
+    without searching the heap.
+
+    update_all() sets the priorities of all keys at once and restores
+    the heap with one heapify in O(n). preview() reads the k first keys
+    in order of priorities in O(k log k) without changing the heap.
+*/
+template <typename Key, typename Priority, typename Compare = std::less<Priority>>
+class IndexedHeap {
+public:
+    typedef std::pair<Key, Priority> value_type;
+
+    size_t size() const {
+        return entries.size();
+    }
+
+    bool empty() const {
+        return entries.empty();
+    }
+
+    bool contains(const Key &key) const {
+        return positions.count(key) != 0;
+    }
+
+    // entry with the minimal priority
+    const value_type & top() const {
+        return entries.front();
+    }
+
+    const Priority & priority(const Key &key) const {
+        return entries[positions.find(key)->second].second;
+    }
+
+    // inserts the key or changes its priority
+    void push(const Key &key, const Priority &priority) {
+        auto it = positions.find(key);
+        if (it != positions.end()) {
+            update(it->second, priority);
+            return;
+        }
+
+        entries.push_back(value_type(key, priority));
+        positions[key] = entries.size() - 1;
+        sift_up(entries.size() - 1);
+    }
+
+    void pop() {
+        remove(0);
+    }
+
+    bool erase(const Key &key) {
+        auto it = positions.find(key);
+        if (it == positions.end())
+            return false;
+
+        remove(it->second);
+        return true;
+    }
+
+    // new priority of every key is estimate(key)
+    template <typename Estimate>
+    void update_all(Estimate estimate) {
+        update_all(estimate, [](const size_t &count, const std::function<void(size_t, size_t)> &task) {
+            task(0, count);
+        });
+    }
+
+    // for_each_range(count, task) calls task(begin, end) on parts of [0, count),
+    // possibly in parallel, so estimate must only read shared state
+    template <typename Estimate, typename ForEachRange>
+    void update_all(Estimate estimate, ForEachRange for_each_range) {
+        for_each_range(entries.size(), [this, &estimate](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i)
+                entries[i].second = estimate(entries[i].first);
+        });
+
+        for (size_t i = entries.size() / 2; i-- > 0; )
+            sift_down(i);
+    }
+
+    // visits keys in order of priorities while visit(key, priority) is true
+    template <typename Visit>
+    void preview(Visit visit) const {
+        if (entries.empty())
+            return;
+
+        // the next key is the best one of the children of visited keys
+        auto later = [this](const size_t &a, const size_t &b) {
+            return compare(entries[b].second, entries[a].second);
+        };
+
+        frontier.clear();
+        frontier.push_back(0);
+        while (!frontier.empty()) {
+            std::pop_heap(frontier.begin(), frontier.end(), later);
+            size_t index = frontier.back();
+            frontier.pop_back();
+
+            if (!visit(entries[index].first, entries[index].second))
+                return;
+
+            for (size_t child = 2 * index + 1; child <= 2 * index + 2 && child < entries.size(); ++child) {
+                frontier.push_back(child);
+                std::push_heap(frontier.begin(), frontier.end(), later);
+            }
+        }
+    }
+
+private:
+    void update(const size_t index, const Priority &priority) {
+        bool decreased = compare(priority, entries[index].second);
+        entries[index].second = priority;
+        if (decreased)
+            sift_up(index);
+        else
+            sift_down(index);
+    }
+
+    // index is taken by value, it may refer to the erased position
+    void remove(const size_t index) {
+        positions.erase(entries[index].first);
+
+        size_t last = entries.size() - 1;
+        if (index != last) {
+            entries[index] = std::move(entries[last]);
+            positions[entries[index].first] = index;
+        }
+        entries.pop_back();
+
+        if (index < entries.size()) {
+            sift_up(index);
+            sift_down(index);
+        }
+    }
+
+    void sift_up(size_t index) {
+        value_type entry = std::move(entries[index]);
+        while (index > 0) {
+            size_t parent = (index - 1) / 2;
+            if (!compare(entry.second, entries[parent].second))
+                break;
+            place(index, std::move(entries[parent]));
+            index = parent;
+        }
+        place(index, std::move(entry));
+    }
+
+    void sift_down(size_t index) {
+        value_type entry = std::move(entries[index]);
+        size_t count = entries.size();
+        while (true) {
+            size_t child = 2 * index + 1;
+            if (child >= count)
+                break;
+            if (child + 1 < count && compare(entries[child + 1].second, entries[child].second))
+                ++child;
+            if (!compare(entries[child].second, entry.second))
+                break;
+            place(index, std::move(entries[child]));
+            index = child;
+        }
+        place(index, std::move(entry));
+    }
+
+    void place(const size_t &index, value_type &&entry) {
+        entries[index] = std::move(entry);
+        positions.find(entries[index].first)->second = index;
+    }
+
+private:
+    std::vector<value_type> entries;
+    FlatHashMap<Key, size_t> positions;
+    Compare compare;
+
+    // heap of indices for preview(), kept to reuse its memory
+    mutable std::vector<size_t> frontier;
+};
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <new>
+#include <memory>
+#include <vector>
+#include <cstdlib>
+#include <cstddef>
+#include <iostream>
+
+#ifdef USE_HUGE_PAGES
+#include <sys/mman.h>
+#endif
+
+
+/*
+    Arena for the nodes of node based containers of a cache.
+
+    Memory is taken from the system in chunks and cut into blocks of
+    sizes rounded up to 16 bytes. A freed block goes to the free list of
+    its size and is reused by the next node of that size, so the hot path
+    does not reach malloc. All chunks are released at once with the arena.
+
+    With USE_HUGE_PAGES chunks are 2 MB aligned and advised to be backed
+    by transparent huge pages.
+*/
+class NodeArena {
+public:
+    NodeArena() :
+        next_block(nullptr),
+        chunk_end(nullptr),
+        chunk_size(MIN_CHUNK_SIZE) {}
+
+    ~NodeArena() {
+        for (auto chunk : chunks)
+            free(chunk);
+    }
+
+    NodeArena(const NodeArena &) = delete;
+    NodeArena & operator = (const NodeArena &) = delete;
+
+    void * allocate(const size_t &bytes) {
+        size_t size_class = (bytes + ALIGNMENT - 1) / ALIGNMENT;
+        if (size_class >= MAX_CLASSES)
+            return ::operator new(bytes);
+
+        if (size_class >= free_lists.size())
+            free_lists.resize(size_class + 1, nullptr);
+
+        FreeBlock *block = free_lists[size_class];
+        if (block != nullptr) {
+            free_lists[size_class] = block->next;
+            return block;
+        }
+
+        size_t block_size = size_class * ALIGNMENT;
+        if (next_block == nullptr || size_t(chunk_end - next_block) < block_size)
+            add_chunk();
+
+        void *result = next_block;
+        next_block += block_size;
+        return result;
+    }
+
+    void deallocate(void *pointer, const size_t &bytes) {
+        size_t size_class = (bytes + ALIGNMENT - 1) / ALIGNMENT;
+        if (size_class >= MAX_CLASSES) {
+            ::operator delete(pointer);
+            return;
+        }
+
+        FreeBlock *block = static_cast<FreeBlock *>(pointer);
+        block->next = free_lists[size_class];
+        free_lists[size_class] = block;
+    }
+
+private:
+    struct FreeBlock {
+        FreeBlock *next;
+    };
+
+    void add_chunk() {
+        void *chunk = nullptr;
+#ifdef USE_HUGE_PAGES
+        if (posix_memalign(&chunk, HUGE_PAGE_SIZE, HUGE_PAGE_SIZE) != 0)
+            chunk = nullptr;
+        else
+            madvise(chunk, HUGE_PAGE_SIZE, MADV_HUGEPAGE);
+        chunk_size = HUGE_PAGE_SIZE;
+#else
+        chunk = malloc(chunk_size);
+#endif
+        if (chunk == nullptr) {
+            std::cerr << "[ERROR] Error while allocating memory for cache nodes" << std::endl;
+            throw std::bad_alloc();
+        }
+
+        chunks.push_back(chunk);
+        next_block = static_cast<char *>(chunk);
+        chunk_end = next_block + chunk_size;
+
+        // small caches take small chunks
+        if (chunk_size < MAX_CHUNK_SIZE)
+            chunk_size *= 2;
+    }
+
+private:
+    static const size_t ALIGNMENT = 16;
+    static const size_t MAX_CLASSES = 32;
+    static const size_t MIN_CHUNK_SIZE = 16 << 10;
+    static const size_t MAX_CHUNK_SIZE = 1 << 20;
+#ifdef USE_HUGE_PAGES
+    static const size_t HUGE_PAGE_SIZE = 2 << 20;
+#endif
+
+    std::vector<void *> chunks;
+    std::vector<FreeBlock *> free_lists;
+    char *next_block;
+    char *chunk_end;
+    size_t chunk_size;
+};
+
+
+/*
+    Allocator of containers backed by a NodeArena.
+    A default constructed allocator creates a new arena, copies and
+    rebound allocators share it, so a container and its nodes use one arena.
+*/
+template <typename T>
+class PoolAllocator {
+public:
+    typedef T value_type;
+
+    PoolAllocator() :
+        arena(std::make_shared<NodeArena>()) {}
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U> &other) :
+        arena(other.arena) {}
+
+    T * allocate(const size_t &count) {
+        return static_cast<T *>(arena->allocate(count * sizeof(T)));
+    }
+
+    void deallocate(T *pointer, const size_t &count) {
+        arena->deallocate(pointer, count * sizeof(T));
+    }
+
+    template <typename U>
+    bool operator == (const PoolAllocator<U> &other) const {
+        return arena == other.arena;
+    }
+
+    template <typename U>
+    bool operator != (const PoolAllocator<U> &other) const {
+        return arena != other.arena;
+    }
+
+private:
+    template <typename U> friend class PoolAllocator;
+
+    std::shared_ptr<NodeArena> arena;
+};
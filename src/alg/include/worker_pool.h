@@ -0,0 +1,112 @@
+#pragma once
+
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <functional>
+#include <condition_variable>
+
+
+/*
+    Fixed set of threads for data parallel passes of a cache.
+
+    for_each_range(count, task) splits [0, count) into one part per thread
+    and calls task(begin, end) for every part. The calling thread takes the
+    first part, so a pool of N threads starts N - 1 workers, which sleep
+    between passes.
+*/
+class WorkerPool {
+public:
+    explicit WorkerPool(const size_t &threads) :
+        count(0),
+        pending(0),
+        generation(0),
+        stopping(false)
+    {
+        for (size_t i = 1; i < threads; ++i)
+            workers.push_back(std::thread(&WorkerPool::work, this, i));
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto &worker : workers)
+            worker.join();
+    }
+
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool & operator = (const WorkerPool &) = delete;
+
+    size_t threads() const {
+        return workers.size() + 1;
+    }
+
+    // returns when task is done on all parts
+    void for_each_range(const size_t &count, const std::function<void(size_t, size_t)> &task) {
+        if (workers.empty()) {
+            task(0, count);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            this->task = task;
+            this->count = count;
+            pending = workers.size();
+            ++generation;
+        }
+        wake.notify_all();
+
+        task(0, part_begin(1, count));
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return pending == 0; });
+        this->task = nullptr;
+    }
+
+private:
+    size_t part_begin(const size_t &part, const size_t &count) const {
+        return count * part / threads();
+    }
+
+    void work(const size_t &part) {
+        size_t seen = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [this, seen] { return stopping || generation != seen; });
+            if (stopping)
+                return;
+            seen = generation;
+
+            std::function<void(size_t, size_t)> current = task;
+            size_t begin = part_begin(part, count);
+            size_t end = part_begin(part + 1, count);
+            lock.unlock();
+
+            if (begin < end)
+                current(begin, end);
+
+            lock.lock();
+            if (--pending == 0)
+                done.notify_one();
+        }
+    }
+
+private:
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+
+    // current pass
+    std::function<void(size_t, size_t)> task;
+    size_t count;
+    size_t pending;
+    size_t generation;
+    bool stopping;
+};
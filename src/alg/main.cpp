@@ -7,6 +7,7 @@
 #include "midpointlru.h"
 #include "pop_caching.h"
 #include "timestamps.h"
+#include "trace_pipeline.h"
 
 #include "defs.h"
 #include "config.h"
@@ -29,21 +30,21 @@
 #include <vector>
 #include <unordered_set>
 #include <unordered_map>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <deque>
 
 
 struct PeriodStat;
 struct TotalStat;
+struct SamplingStat;
 typedef long long PoPId;
 typedef long long PoPSize;
 typedef std::vector<PoPId> VecPoP;
 typedef std::vector<PoPSize> VecPoPSize;
 typedef std::vector<PeriodStat> PeriodsStatistics;
-typedef std::unordered_map<std::string, size_t> ContentSizes;
-typedef std::unordered_map<PoPId, PeriodsStatistics> PIDsPeriodStatistics;
-typedef std::unordered_map<PoPId, TotalStat> PIDsTotalStats;
-typedef std::unordered_map<PoPId, HistoryManager> PIDsHistoryManagers;
-typedef std::unordered_map<PoPId, SizeFilter> PIDsSizeFilters;
-typedef std::unordered_map<PoPId, size_t> PIDsPeriodEnds;
 
 
 struct PeriodStat {
@@ -100,51 +101,299 @@ struct TotalStat {
     }
 };
 
+/* per content statistics of a sampled run */
+struct SampledContentStat {
+    size_t hit, requests;
+    size_t hit_bytes, requests_bytes;
+
+    SampledContentStat() :
+        hit(0), requests(0),
+        hit_bytes(0), requests_bytes(0) {}
+};
+
+struct SamplingStat {
+    std::vector<SampledContentStat> contents;
+
+    void update(const ContentId &id, const size_t &size, const bool &hit) {
+        if (id >= contents.size())
+            contents.resize(id + 1);
+
+        SampledContentStat &content = contents[id];
+        content.requests += 1;
+        content.requests_bytes += size;
+        if (hit) {
+            content.hit += 1;
+            content.hit_bytes += size;
+        }
+    }
+
+    /* standard error of the hit rate caused by sampling of contents */
+    /* with the given rate, ratio estimator over the sampled contents */
+    float object_hit_rate_error(const double &rate) const {
+        return hit_rate_error(rate, false);
+    }
+
+    float byte_hit_rate_error(const double &rate) const {
+        return hit_rate_error(rate, true);
+    }
+
+private:
+    float hit_rate_error(const double &rate, const bool &bytes) const {
+        double hits = 0.0, requests = 0.0;
+        for (auto &content : contents) {
+            hits += bytes ? content.hit_bytes : content.hit;
+            requests += bytes ? content.requests_bytes : content.requests;
+        }
+
+        if (requests == 0.0)
+            return -1.0;
+
+        double hit_rate = hits / requests;
+        double sum = 0.0;
+        for (auto &content : contents) {
+            double residual = bytes ?
+                content.hit_bytes - hit_rate * content.requests_bytes :
+                content.hit - hit_rate * content.requests;
+            sum += residual * residual;
+        }
+
+        return std::sqrt((1.0 - rate) * sum) / requests;
+    }
+};
+
+/* parameters of the simulation shared by all PoPs, read only during replay */
+struct SimulationContext {
+    size_t period_size;
+    size_t start_pre_push;
+    float cache_hot_content;
+    bool sampling;
+    bool concurrent;
+    PrePush *pre_push;
+    const ContentSizes *content_sizes;
+};
+
+/* request of one PoP, stored in the per-PoP trace index */
+struct PoPRequest {
+    size_t time;
+    size_t size;
+    size_t position;
+    ContentId id;
+
+    PoPRequest() : time(0), size(0), position(0), id(0) {}
+    PoPRequest(const size_t &time, const size_t &size, const size_t &position, const ContentId &id) :
+        time(time), size(size), position(position), id(id) {}
+};
+typedef std::vector<PoPRequest> PoPRequests;
+
+template<typename Cache>
+void make_pre_push(Cache &cache, PrePush &pre_push,
+                   HistoryManager &history_manager, 
+                   SizeFilter &size_filter,
+                   const ContentSizes &contentSizes,
+                   const float &cache_hot_content,
+                   const size_t &position,
+                   std::ostream &log) {
+    /* take hot content from cache */
+    VecContentId hot_content = cache.get_hot_content(cache_hot_content);
+
+    hot_content = pre_push.get_pre_push_list(hot_content, history_manager);
+
+    /* add hot_content to cache */
+    /* hot_content may contains elements which are already in cache */
+    /* content which was not requested yet has unknown size and is skipped, */
+    /* the position keeps the same contents known when PoPs are replayed concurrently */
+    int count  = 0;
+    float size = 0.0;
+    for (auto &content : hot_content) {
+        if (!contentSizes.requested_by(content, position))
+            continue;
+
+        if (cache.find(content) == nullptr) {
+            ++count;
+            size = (float)contentSizes.get(content);
+            if (size_filter.admit_object(content, size, history_manager) == true)
+                cache.put(content, NoValue());
+        }
+    }
+
+    print_current_data_and_time(log, std::string("Pre Push added: ") +
+                                     ToString<size_t>(hot_content.size()) +
+                                     std::string(", new elements: ") +
+                                     ToString<int>(count));
+}
+
+
+/* settings of a cache from the config file, only PoPCaching has them */
+template <typename Cache>
+void configure_cache(Cache &cache, Config &config) {}
+
+template <typename Key, typename Value, size_t D>
+void configure_cache(PoPCaching<Key, Value, D> &cache, Config &config) {
+    if (config.contains("POP_CACHING_CONTEXT_SPACE_SIZE"))
+        cache.setContextSpaceBudget(std::max(config.get_int_by_name("POP_CACHING_CONTEXT_SPACE_SIZE"), 1));
+    if (config.contains("POP_CACHING_ESTIMATION_THREADS"))
+        cache.setEstimationThreads(std::max(config.get_int_by_name("POP_CACHING_ESTIMATION_THREADS"), 1));
+}
+
+
+/* progress lines of PoPs replayed concurrently are written one at a time */
+std::mutex progress_mutex;
+
+
+/* cache and statistics of one PoP, independent from other PoPs */
+template <typename Cache>
+struct PoPState {
+    PoPId pid;
+    PoPSize pid_size;
+    Cache cache;
+    PeriodsStatistics period_statistics;
+    TotalStat total_statistics;
+    SamplingStat sampling_statistics;
+    HistoryManager history_manager;
+    SizeFilter size_filter;
+    size_t prev_period_end;
+    /* messages of a concurrent replay, printed after all PoPs are done */
+    std::ostringstream log_buffer;
+
+    PoPState(const PoPId &pid, const PoPSize &pid_size, const size_t &cache_size,
+             const size_t &learn_limit, const size_t &period, Config &config) :
+        pid(pid),
+        pid_size(pid_size),
+        cache(cache_size, learn_limit, period),
+        period_statistics(1),
+        history_manager(config),
+        size_filter(config),
+        prev_period_end(0)
+    {
+        cache.prepare_cache();
+        configure_cache(cache, config);
+    }
+
+    void start(const size_t &start_time) {
+        prev_period_end = start_time;
+        period_statistics.back().start = start_time;
+    }
+
+    /* position is the index of the request among all requests of the trace */
+    void process(const ContentId &id, const size_t &access_time, const size_t &size,
+                 const size_t &position, const SimulationContext &context)
+    {
+        if ((access_time - prev_period_end) >= context.period_size) {
+            /* now start for pre_push and size_filter are the same */
+            if (period_statistics.size() >= context.start_pre_push) {
+                std::ostream &log = context.concurrent ? log_buffer : std::cout;
+                size_filter.update_threshold(history_manager, *context.content_sizes);
+                print_current_data_and_time(log, std::string("[SizeFilter] new threshold -> ") +
+                    ToString<float>(size_filter.get_threshold()));
+
+                make_pre_push(cache,
+                              *context.pre_push,
+                              history_manager,
+                              size_filter,
+                              *context.content_sizes,
+                              context.cache_hot_content,
+                              position,
+                              log);
+            }
+            period_statistics.back().end = access_time;
+            period_statistics.push_back(PeriodStat());
+            period_statistics.back().start = access_time;
+            prev_period_end = access_time;
+            history_manager.start_new_period();
+        }
+
+        history_manager.update_object_history(id, period_statistics.size());
+
+        bool hit = (cache.find(id, access_time) != nullptr);
+        if (!hit) {
+            if (size_filter.admit_object(id, (float)size, history_manager) == true) {
+                cache.put(id, NoValue(), access_time);
+            }
+        } else {
+            total_statistics.hit += 1;
+            total_statistics.hit_bytes += size;
+            period_statistics.back().hit += 1;
+            period_statistics.back().hit_bytes += size;
+        }
+
+        total_statistics.requests += 1;
+        total_statistics.requests_bytes += size;
+        period_statistics.back().requests += 1;
+        period_statistics.back().requests_bytes += size;
+
+        if (context.sampling)
+            sampling_statistics.update(id, size, hit);
+
+        if (total_statistics.requests % 1000 == 0) {
+            std::lock_guard<std::mutex> lock(progress_mutex);
+            std::cerr <<  "PID: " << 
+                          pid << 
+                          " Process " << 
+                          total_statistics.requests 
+                          << std::endl;
+        }
+    }
+
+    void replay(const PoPRequests &requests, const SimulationContext &context) {
+        for (auto &request : requests)
+            process(request.id, request.time, request.size, request.position, context);
+    }
+};
+
 template <typename Cache>
-void print_algorithm_results(PIDsTotalStats &pids_total_statistics, 
-                             PIDsPeriodStatistics &pids_period_statistics, 
-                             std::unordered_map<PoPId, Cache> &pids_caches, 
-                             VecPoP &pids,
-                             VecPoPSize &pids_sizes)
+void print_algorithm_results(std::vector<PoPState<Cache> *> &pop_states,
+                             const double &sampling_rate)
 {
     std::cout << "Algorithm results:" << std::endl;
 
-    for (size_t i = 0; i < pids.size(); ++i) {
-        PoPId pid = pids[i];
-        PoPSize pid_size = pids_sizes[i];
+    for (auto state : pop_states) {
+        PoPId pid = state->pid;
+        PoPSize pid_size = state->pid_size;
         std::cout << "PID: " << pid << " PID size: " << pid_size << std::endl;
-        Cache cache = pids_caches[pid];
+        Cache &cache = state->cache;
+        TotalStat &total_statistics = state->total_statistics;
+        PeriodsStatistics &period_statistics = state->period_statistics;
         std::cout << "Cache size " 
                   << pid_size * 1024 * 1024 
                   << " Kbytes" 
                   << std::endl;
 
         std::cout << "Total Object Hit Rate " 
-                  << pids_total_statistics[pid].object_hit_rate()
+                  << total_statistics.object_hit_rate()
                   << std::endl;
 
         std::cout << "Total Byte Hit Rate "
-                  << pids_total_statistics[pid].byte_hit_rate() 
+                  << total_statistics.byte_hit_rate() 
                   << std::endl;
 
         std::cout << "Average Object Hit Rate " <<
-                  pids_total_statistics[pid].average_object_hit_rate(pids_period_statistics[pid])
+                  total_statistics.average_object_hit_rate(period_statistics)
                   << std::endl;
 
         std::cout << "Average Byte Hit Rate " 
-                  << pids_total_statistics[pid].average_byte_hit_rate(pids_period_statistics[pid])
+                  << total_statistics.average_byte_hit_rate(period_statistics)
                   << std::endl;
 
+        if (sampling_rate < 1.0) {
+            std::cout << "Sampling rate " << sampling_rate << std::endl;
+            std::cout << "Object Hit Rate standard error "
+                      << state->sampling_statistics.object_hit_rate_error(sampling_rate)
+                      << std::endl;
+            std::cout << "Byte Hit Rate standard error "
+                      << state->sampling_statistics.byte_hit_rate_error(sampling_rate)
+                      << std::endl;
+        }
+
         std::cout << "Cache status:" << std::endl;
-        std::cout << "Total Requests " << pids_total_statistics[pid].requests << std::endl;
+        std::cout << "Total Requests " << total_statistics.requests << std::endl;
         std::cout << "Cache size (in Kbytes) "  << cache.getCacheSize() << std::endl;
         std::cout << "Cache size (in objects) " << cache.elementsCount() << std::endl;
         std::cout << std::endl; std::cout << std::endl; std::cout << std::endl;
 
 
-        std::cout << "Statistics for " << pids_period_statistics[pid].size() << " days" << std::endl;
+        std::cout << "Statistics for " << period_statistics.size() << " days" << std::endl;
 
-        for (auto &period : pids_period_statistics[pid]) {
+        for (auto &period : period_statistics) {
             std::cout << "Start " << period.start << " End " << period.end
                       << " Duration " << period.duration()
                       << std::endl;
@@ -167,59 +416,6 @@ void print_algorithm_results(PIDsTotalStats &pids_total_statistics,
     std::cout << std::endl; std::cout << std::endl; std::cout << std::endl;
 }
 
-template<typename Cache>
-void read_cids_size(Cache &cache, const std::string &filename) {
-    std::fstream input(filename);
-    if (!input.is_open()) {
-        std::cerr << "[ERROR] Error while opening file " 
-                    << filename << std::endl;
-        return;
-    }
-    std::string id;
-    size_t access_time;
-    PoPId pid;
-    size_t size = 0;
-    while (true) {
-        input >> access_time >> pid >> id >> size;
-        if (input.eof() && size == 0) break;
-        cache.addCidSize(id, size);
-        size = 0;
-    }
-    input.close();
-}
-
-template<typename Cache>
-void make_pre_push(Cache &cache, PrePush &pre_push,
-                   HistoryManager &history_manager, 
-                   SizeFilter &size_filter,
-                   Config &config) {
-    float cache_hot_content = config.get_float_by_name("CACHE_HOT_CONTENT");
-
-    /* take hot content from cache */
-    VecStr hot_content = cache.get_hot_content(cache_hot_content);
-
-    hot_content = pre_push.get_pre_push_list(hot_content, history_manager);
-
-    /* add hot_content to cache */
-    /* hot_content may contains elements which are already in cache */
-    ContentSizes contentSizes = cache.getContentSizes();
-    int count  = 0;
-    float size = 0.0;
-    for (auto &content : hot_content) {
-        if (cache.find(content) == nullptr) {
-            ++count;
-            size = (float)contentSizes[content];
-            if (size_filter.admit_object(content, size, history_manager) == true)
-                cache.put(content, content);
-        }
-    }
-
-    print_current_data_and_time(std::string("Pre Push added: ") +
-                                ToString<size_t>(hot_content.size()) +
-                                std::string(", new elements: ") +
-                                ToString<int>(count));
-}
-
 
 template <typename Cache>
 int test(size_t cacheSize, const std::string& filename, Config &config,
@@ -229,44 +425,80 @@ int test(size_t cacheSize, const std::string& filename, Config &config,
     VecPoP pids       = config.get_vector_by_name<PoPId>("PIDS");
     VecPoPSize pids_sizes = config.get_vector_by_name<PoPSize>("PIDS_CACHE_SIZES");
 
+    /* spatial sampling of contents (SHARDS) */
+    /* only requests of sampled contents are simulated, caches are scaled by the same rate */
+    double sampling_rate = 1.0;
+    if (config.contains("SAMPLING_RATE"))
+        sampling_rate = config.get_float_by_name("SAMPLING_RATE");
+    if (sampling_rate <= 0.0 || sampling_rate > 1.0) {
+        std::cerr << "[ERROR] SAMPLING_RATE must be in (0, 1]" << std::endl;
+        return -1;
+    }
+    bool sampling = (sampling_rate < 1.0);
+
+    /* PoPs are independent, with several threads the trace is indexed by PoP */
+    /* and PoPs are replayed concurrently */
+    size_t pop_threads = 1;
+    if (config.contains("POP_THREADS"))
+        pop_threads = std::max(config.get_int_by_name("POP_THREADS"), 1);
+
     /* create all data structures for each PoP */
-    PIDsPeriodStatistics pids_period_statistics;
-    PIDsTotalStats pids_total_statistics;
-    PIDsHistoryManagers pids_history_managers;
-    PIDsSizeFilters pids_size_filters;
-    std::unordered_map<PoPId, Cache> pids_caches;
+    /* states are never moved, caches may keep pointers to themselves */
+    std::unordered_map<PoPId, PoPState<Cache>> pids_states;
+    std::vector<PoPState<Cache> *> pop_states;
 
     for (size_t i = 0; i < pids.size(); ++i) {
         PoPId pop_id = pids[i];
         PoPSize pid_size = pids_sizes[i];
-        pids_period_statistics[pop_id] = PeriodsStatistics();
-        pids_period_statistics[pop_id].push_back(PeriodStat());
-        pids_total_statistics[pop_id]  = TotalStat();
-        pids_history_managers[pop_id]  = HistoryManager(config);
-        pids_size_filters[pop_id] = SizeFilter(config);
-        pids_caches[pop_id] = Cache(pid_size * 1024 * 1024, learn_limit, period);
-        pids_caches[pop_id].prepare_cache();
+        size_t cache_size = static_cast<size_t>(pid_size * 1024 * 1024 * sampling_rate);
+        auto result = pids_states.emplace(std::piecewise_construct,
+                                          std::forward_as_tuple(pop_id),
+                                          std::forward_as_tuple(pop_id, pid_size, cache_size,
+                                                                learn_limit, period, config));
+        pop_states.push_back(&result.first->second);
     }
 
-    size_t period_size = config.get_int_by_name("STAT_PERIOD_SIZE");
-    size_t start_pre_push = config.get_int_by_name("START_PRE_PUSH");
-    
-    PrePush pre_push(config);
-    std::cout << "Total PIDs count: " << pids_caches.size() << std::endl;
-    for (size_t i = 0; i < pids.size(); ++i) {
-        std::cout << "Pid: " << pids[i] << " with cache size: " << pids_caches[pids[i]].size() << std::endl;
+    /* cids are mapped to dense ids, all caches are keyed by ids */
+    ContentInterner interner;
+    PrePush pre_push(config, interner);
+
+    /* cids sizes are shared by all caches */
+    /* size of content is learned on its first request */
+    /* binary trace has sizes of all contents in its objects table */
+    ContentSizes contentSizes;
+
+    SimulationContext context;
+    context.period_size = config.get_int_by_name("STAT_PERIOD_SIZE");
+    context.start_pre_push = config.get_int_by_name("START_PRE_PUSH");
+    context.cache_hot_content = config.get_float_by_name("CACHE_HOT_CONTENT");
+    context.sampling = sampling;
+    context.concurrent = pop_threads > 1;
+    context.pre_push = &pre_push;
+    context.content_sizes = &contentSizes;
+
+    std::cout << "Total PIDs count: " << pids_states.size() << std::endl;
+    for (auto state : pop_states) {
+        std::cout << "Pid: " << state->pid << " with cache size: " << state->cache.size() << std::endl;
     }
     
-    /* read cids sizes for each caches */
-    print_current_data_and_time("Start read cids sizes.");
-    read_cids_size<Cache>(pids_caches[pids[0]], filename);
-    ContentSizes contentSizes = pids_caches[pids[0]].getContentSizes();
-    for (size_t i = 1; i < pids.size(); ++i) {
-        PoPId pid = pids[i];
-        for (auto &elem : contentSizes) {
-            pids_caches[pid].addCidSize(elem.first, elem.second);
+    /* requests are read and parsed in batches by a separate thread */
+    TracePipeline trace;
+    trace.set_sampling_rate(sampling_rate);
+    if (!trace.open(filename, &interner))
+        return -1;
+    const TraceReader &reader = trace.reader();
+
+    if (reader.binary()) {
+        contentSizes.reserve(reader.objects_count());
+        for (size_t object = 0; object < reader.objects_count(); ++object) {
+            if (trace.object_sampled(object))
+                contentSizes.set(trace.object_id(object), reader.object_size(object));
         }
     }
+
+    for (auto state : pop_states) {
+        state->cache.setContentSizes(&contentSizes);
+    }
     print_current_data_and_time("After cache initialization.");
 
     // std::cout << "config start" << std::endl;
@@ -278,76 +510,83 @@ int test(size_t cacheSize, const std::string& filename, Config &config,
     int min_start = now->tm_min;
     int sec_start = now->tm_sec;
 
-    std::ifstream in(filename);
-    
-    std::string id;
-    PoPId pid;
-    size_t access_time, size;
-    in >> access_time >> pid >> id >> size;
+    const RequestBatch *batch = trace.next_batch();
+    if (batch == nullptr) {
+        if (trace.failed())
+            std::cerr << "[ERROR] Error while reading trace " << filename << std::endl;
+        return -1;
+    }
 
-    /* create map with previous period ends */
-    /* initialize periods statistics for each PoP */
-    PIDsPeriodEnds prev_period_ends;
-    for (size_t i = 0; i < pids.size(); ++i) {
-        PoPId pop_id = pids[i];
-        prev_period_ends[pop_id] = access_time;
-        pids_period_statistics[pop_id].back().start = access_time;
+    /* periods of all PoPs start with the first request of the trace */
+    size_t start_time = batch->begin()->time;
+    for (auto state : pop_states) {
+        state->start(start_time);
     }
 
-    while (true) {
-        if (in.eof()) {break;}
+    /* one lookup per request, requests of other PoPs are skipped */
+    std::unordered_map<PoPId, size_t> pop_index;
+    for (size_t i = 0; i < pop_states.size(); ++i) {
+        pop_index[pop_states[i]->pid] = i;
+    }
 
-        if ((access_time - prev_period_ends[pid]) >= period_size) {
-            /* now start for pre_push and size_filter are the same */
-            if (pids_period_statistics[pid].size() >= start_pre_push) {
-                pids_size_filters[pid].update_threshold
-                                       (pids_history_managers[pid], contentSizes);
-                print_current_data_and_time(std::string("[SizeFilter] new threshold -> ") +
-                    ToString<float>(pids_size_filters[pid].get_threshold()));
-
-                make_pre_push(pids_caches[pid],
-                              pre_push,
-                              pids_history_managers[pid],
-                              pids_size_filters[pid],
-                              config);
+    /* per PoP index of the trace, filled when PoPs are replayed concurrently */
+    std::vector<PoPRequests> pop_requests(pop_threads > 1 ? pop_states.size() : 0);
+
+    size_t sampled_requests = 0;
+    do {
+        for (const TraceRequest &request : *batch) {
+            const ContentId &id = request.id;
+            size_t position = sampled_requests++;
+
+            if (!contentSizes.contains(id)) {
+                contentSizes.set(id, request.size, position);
             }
-            pids_period_statistics[pid].back().end = access_time;
-            pids_period_statistics[pid].push_back(PeriodStat());
-            pids_period_statistics[pid].back().start = access_time;
-            prev_period_ends[pid] = access_time;
-            pids_history_managers[pid].start_new_period();
-        }
 
-        // pids_caches[pid].addCidSize(id, size);
-        pids_history_managers[pid].update_object_history
-                                   (id, pids_period_statistics[pid].size());
-        
-        if (pids_caches[pid].find(id, access_time) == nullptr) {
-            if (pids_size_filters[pid].admit_object(id, (float)size, 
-                                        pids_history_managers[pid]) == true) {
-                pids_caches[pid].put(id, id, access_time);
+            auto pop = pop_index.find(request.pid);
+            if (pop == pop_index.end())
+                continue;
+
+            if (pop_requests.empty()) {
+                pop_states[pop->second]->process(id, request.time, request.size, position, context);
+            } else {
+                pop_requests[pop->second].push_back(PoPRequest(request.time, request.size, position, id));
             }
-        } else {
-            pids_total_statistics[pid].hit += 1;
-            pids_total_statistics[pid].hit_bytes += size;
-            pids_period_statistics[pid].back().hit += 1;
-            pids_period_statistics[pid].back().hit_bytes += size;
         }
+    } while ((batch = trace.next_batch()) != nullptr);
 
-        pids_total_statistics[pid].requests += 1;
-        pids_total_statistics[pid].requests_bytes += size;
-        pids_period_statistics[pid].back().requests += 1;
-        pids_period_statistics[pid].back().requests_bytes += size;
+    if (trace.failed()) {
+        std::cerr << "[ERROR] Error while reading trace " << filename << std::endl;
+        return -1;
+    }
 
-        if (pids_total_statistics[pid].requests % 1000 == 0) {
-            std::cerr <<  "PID: " << 
-                          pid << 
-                          " Process " << 
-                          pids_total_statistics[pid].requests 
-                          << std::endl;
-        }
+    if (!pop_requests.empty()) {
+        print_current_data_and_time("Trace was indexed.");
+
+        /* PoPs with more requests are started first */
+        std::vector<size_t> order(pop_states.size());
+        for (size_t i = 0; i < order.size(); ++i)
+            order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [&pop_requests] (const size_t &a, const size_t &b) {
+            return pop_requests[a].size() > pop_requests[b].size();
+        });
+
+        std::atomic<size_t> next_pop(0);
+        auto worker = [&] () {
+            size_t i;
+            while ((i = next_pop++) < order.size()) {
+                pop_states[order[i]]->replay(pop_requests[order[i]], context);
+                PoPRequests().swap(pop_requests[order[i]]);
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < std::min(pop_threads, order.size()); ++i)
+            workers.push_back(std::thread(worker));
+        for (auto &thread : workers)
+            thread.join();
 
-        in >> access_time >> pid >> id >> size;
+        for (auto state : pop_states)
+            std::cout << state->log_buffer.str();
     }
 
     now = print_current_data_and_time("Algorithm was finished.");
@@ -357,18 +596,102 @@ int test(size_t cacheSize, const std::string& filename, Config &config,
                 <<  time / 3600  << "  hours " 
                 << (time % 3600) / 60  << " mins " 
                 << (time % 3600) % 60 << " secs" << std::endl;
+    std::cout   << "Trace reading time -> " << trace.read_time() << " secs" << std::endl;
+    if (sampling) {
+        std::cout << "Sampling rate " << sampling_rate 
+                  << ", simulated requests " << sampled_requests
+                  << " of " << trace.records_count() << std::endl;
+    }
 
-    print_algorithm_results<Cache>(pids_total_statistics, 
-                                   pids_period_statistics,
-                                   pids_caches,
-                                   pids, 
-                                   pids_sizes);
+    print_algorithm_results<Cache>(pop_states, sampling_rate);
     
     return 0;
 }
 
+/*
+    Replay the content ids of the trace through a lookup table the way a
+    cache uses it: find on every request, insert on a miss and erase the
+    oldest inserted key when the table is full.
+*/
+template <typename Map>
+double replay_lookups(const VecContentId &ids, const size_t &capacity, size_t &hits) {
+    auto start = std::chrono::steady_clock::now();
+    Map lookup;
+    std::deque<ContentId> inserted;
+    hits = 0;
+    for (size_t position = 0; position < ids.size(); ++position) {
+        const ContentId &id = ids[position];
+        if (lookup.find(id) != lookup.end()) {
+            ++hits;
+            continue;
+        }
+
+        lookup[id] = position;
+        inserted.push_back(id);
+        if (inserted.size() > capacity) {
+            lookup.erase(inserted.front());
+            inserted.pop_front();
+        }
+    }
+    std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+    return seconds.count();
+}
+
+/*
+    Compare probe cost of std::unordered_map and FlatHashMap on the trace
+*/
+int bench_lookup(const std::string &filename) {
+    ContentInterner interner;
+    TracePipeline trace;
+    if (!trace.open(filename, &interner))
+        return -1;
+
+    VecContentId ids;
+    const RequestBatch *batch;
+    while ((batch = trace.next_batch()) != nullptr) {
+        for (const TraceRequest &request : *batch)
+            ids.push_back(request.id);
+    }
+
+    if (trace.failed()) {
+        std::cerr << "[ERROR] Error while reading trace " << filename << std::endl;
+        return -1;
+    }
+
+    const size_t passes = 5;
+    std::cout << "Requests " << ids.size() << ", contents " << interner.size() << std::endl;
+    for (size_t capacity = 1024; ; capacity *= 16) {
+        double unordered_time = 0, flat_time = 0;
+        size_t unordered_hits = 0, flat_hits = 0;
+        for (size_t pass = 0; pass < passes; ++pass) {
+            unordered_time += replay_lookups<std::unordered_map<ContentId, size_t>>(ids, capacity, unordered_hits);
+            flat_time += replay_lookups<FlatHashMap<ContentId, size_t>>(ids, capacity, flat_hits);
+        }
+
+        if (unordered_hits != flat_hits) {
+            std::cerr << "[ERROR] Lookup tables disagree on the trace" << std::endl;
+            return -1;
+        }
+
+        double requests = double(ids.size()) * passes;
+        std::cout << "Capacity " << capacity << " keys, hits " << flat_hits << std::endl;
+        std::cout << "    std::unordered_map " << unordered_time * 1e9 / requests << " ns per request" << std::endl;
+        std::cout << "    FlatHashMap        " << flat_time * 1e9 / requests << " ns per request" << std::endl;
+
+        // the last capacity keeps all contents
+        if (capacity >= interner.size())
+            break;
+    }
+
+    return 0;
+}
+
 int main(int argc, const char* argv[]) {
-    if (argc != 7) {
+    if (argc == 3 && std::string(argv[1]) == "--bench-lookup")
+        return bench_lookup(argv[2]);
+
+    // the last optional parameter is K of LRU-K
+    if (argc != 7 && argc != 8) {
         std::cerr << "Error in input parameters" << std::endl;
         return -1;
     }
@@ -387,44 +710,56 @@ int main(int argc, const char* argv[]) {
     std::string filename = argv[5];
 
     if (cacheType == "mid") {
-        return test<MidPointLRUCache<std::string, std::string>>(cacheSize, filename, config);
+        return test<MidPointLRUCache<ContentId, NoValue>>(cacheSize, filename, config);
     }
 
     if (cacheType == "lru") {
-        return test<LRUCache<std::string, std::string>>(cacheSize, filename, config);
+        return test<LRUCache<ContentId, NoValue>>(cacheSize, filename, config);
     }
 
     if (cacheType == "lru_k") {
-        return test<LRU_K_Cache<std::string, std::string>>
-                (cacheSize, filename, config);
-    }    
+        size_t history_len = argc == 8 ? std::stoll(std::string(argv[7]), &sz, 0) : 2;
+        switch (history_len) {
+            case 1:
+                return test<LRU_K_Cache<ContentId, NoValue, 1>>(cacheSize, filename, config, learn_limit, period);
+            case 2:
+                return test<LRU_K_Cache<ContentId, NoValue, 2>>(cacheSize, filename, config, learn_limit, period);
+            case 3:
+                return test<LRU_K_Cache<ContentId, NoValue, 3>>(cacheSize, filename, config, learn_limit, period);
+            case 4:
+                return test<LRU_K_Cache<ContentId, NoValue, 4>>(cacheSize, filename, config, learn_limit, period);
+            default:
+                std::cerr << "[ERROR] LRU-K supports K from 1 to 4, got " << history_len << std::endl;
+                return -1;
+        }
+    }
 
     if (cacheType == "pop_caching") {
-        return test<PoPCaching>(cacheSize, filename, config, learn_limit, period);
+        return test<PoPCaching<ContentId, NoValue>>(cacheSize, filename, config, learn_limit, period);
     }
 
     if (cacheType == "lfu") {
-        return test<LFUCache<std::string, std::string>>(cacheSize, filename, config);
+        return test<LFUCache<ContentId, NoValue>>(cacheSize, filename, config);
     }
 
     if (cacheType == "2q") {
-        return test<TwoQCache<std::string, std::string>>(cacheSize, filename, config);
+        return test<TwoQCache<ContentId, NoValue>>(cacheSize, filename, config);
     }
 
     if (cacheType == "s4lru") {
-        return test<SNLRUCache<std::string, std::string>>(cacheSize, filename, config);
+        return test<SNLRUCache<ContentId, NoValue>>(cacheSize, filename, config);
     }
 
     if (cacheType == "fifo") {
-        return test<FifoCache<std::string, std::string>>(cacheSize, filename, config);
+        return test<FifoCache<ContentId, NoValue>>(cacheSize, filename, config);
     }
 
     if (cacheType == "mq") {
-        return test<MQCache<std::string, std::string>>(cacheSize, filename, config);
+        return test<MQCache<ContentId, NoValue>>(cacheSize, filename, config);
     }
 
     if (cacheType == "arc") {
-        return test<ARCCache<std::string, std::string>>(cacheSize, filename, config);
+        return test<ARCCache<ContentId, NoValue>>(cacheSize, filename, config);
     }
 
     std::cout << "Unknown cache type " << cacheType << "\n";
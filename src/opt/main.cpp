@@ -1,8 +1,7 @@
-#include <list>
 #include <set>
-#include <queue>
 #include <ctime>
 #include <cassert>
+#include <cstdint>
 #include <cstdlib>
 #include <fstream>
 #include <sstream>
@@ -12,29 +11,28 @@
 #include <unordered_map>
 #include <unordered_set>
 #include "timestamps.h"
+#include "trace_pipeline.h"
+#include "mapped_array.h"
 
-typedef std::unordered_map<std::string, size_t> ContentSizes;
+#include <unistd.h>
+#include <sys/mman.h>
+
+typedef uint32_t ContentId;
+typedef std::vector<size_t> ContentSizes;
 
-template<typename T>
-class custom_priority_queue : public std::priority_queue<T, std::vector<T>>
-{
-public:
-    bool remove(const T& value) {
-        auto it = std::find(this->c.begin(), this->c.end(), value);
-        if (it != this->c.end()) {
-            this->c.erase(it);
-            std::make_heap(this->c.begin(), this->c.end(), this->comp);
-            return true;
-        } else {
-            return false;
-        }
-    }
-};
 
+/*
+    Belady's OPT over a trace loaded into memory.
 
+    The trace is kept as an array of content ids. A backward pass computes
+    for every request the position of the next request of the same content,
+    so the eviction priority of a cached content is a single array read.
+    Both arrays are moved to files next to the trace when they do not fit
+    into half of the physical memory.
+*/
 class OptCache {
-    typedef std::unordered_set<std::string> Lookup;
-    typedef std::unordered_map<std::string, std::deque<size_t> > ItemPositions;
+    // cached contents ordered by the position of their next request
+    typedef std::set<std::pair<uint64_t, ContentId>> EvictionQueue;
 public:
     OptCache(size_t size, const std::string &fileName) :
             cacheSize(size),
@@ -43,67 +41,80 @@ public:
             currentCacheSize(0),
             requestsFileName(fileName),
             cacheHit(0),
-            totalRequests(0)
+            totalRequests(0),
+            neverUsed(0),
+            loaded_(false),
+            ids(spill_directory(fileName), memory_limit() / 3),
+            nextUse(spill_directory(fileName), memory_limit() / 3 * 2)
     {
+        ContentInterner interner;
+        TracePipeline trace;
+        if (!trace.open(fileName, &interner))
+            return;
+
+        const TraceReader &reader = trace.reader();
+        if (reader.binary()) {
+            contentSizes.resize(interner.size());
+            for (size_t object = 0; object < reader.objects_count(); ++object)
+                contentSizes[trace.object_id(object)] = reader.object_size(object);
+        }
 
-        std::ifstream in(fileName);
-        size_t pos = 0;
-
-        while (true) {
-            size_t access_time;
-            std::string id;
-            size_t size;
-
-            in >> access_time;
-            in >> id;
-            in >> size;
-
-            if (in.eof()) {
-                break;
+        // size of content is the size of its first request
+        const RequestBatch *batch;
+        while ((batch = trace.next_batch()) != nullptr) {
+            for (const TraceRequest &request : *batch) {
+                if (!ids.push_back(request.id))
+                    return;
+                if (request.id == contentSizes.size())
+                    contentSizes.push_back(request.size);
             }
+        }
 
-            itemPositions[id].push_back(pos);
-            auto it = itemPositions.find(id);
-            if (it->second.size() == 1) {
-                PositionHolder posHolder = PositionHolder(pos, it);
-                IdPositionHolderMap[id] = posHolder;
-                contentSizes[id] = size;
-            }
-            ++pos;
+        if (trace.failed()) {
+            std::cerr << "[ERROR] Error while reading trace " << fileName << std::endl;
+            return;
         }
 
-        pos += 10;
-        for (auto & item : itemPositions) {
-            auto & positionList = item.second;
-            positionList.push_back(pos);
+        // position of the next request of the same content
+        size_t requestsCount = ids.size();
+        neverUsed = requestsCount + 10;
+        if (!nextUse.resize(requestsCount))
+            return;
+
+        std::vector<uint64_t> lastUse(contentSizes.size(), neverUsed);
+        for (size_t position = requestsCount; position-- > 0; ) {
+            ContentId id = ids[position];
+            nextUse[position] = lastUse[id];
+            lastUse[id] = position;
         }
+
+        ids.advise(MADV_SEQUENTIAL);
+        nextUse.advise(MADV_SEQUENTIAL);
+        cachedNextUse.assign(contentSizes.size(), uint64_t(NOT_CACHED));
+        loaded_ = true;
     }
 
-    void modifyPositionHolder(const std::string & id) {
-        auto iter = itemPositions.find(id);
-        auto & positionList = iter->second;
-        if (positionList.size() >= 2) {
-            positionList.pop_front();
-            auto position = positionList.front();
-            if (lookup.find(id) != lookup.end()) {
-                PositionHolder oldPosHolder = IdPositionHolderMap[id];
-                if (!currentPositionsQueue.remove(oldPosHolder))
-                    std::cout << "Error modify" << std::endl;
-            }
-            PositionHolder newPosHolder = PositionHolder(position, iter);
-            IdPositionHolderMap[id] = newPosHolder;
-        }
+    bool loaded() const {
+        return loaded_;
     }
 
-    bool find(const std::string & id) {
-        if (lookup.find(id) == lookup.end())
-            return false;
+    bool outOfCore() const {
+        return ids.out_of_core() || nextUse.out_of_core();
+    }
 
-        // modify position holder for id
-        modifyPositionHolder(id);
+    size_t requestsCount() const {
+        return ids.size();
+    }
+
+    bool find(const size_t & position) {
+        ContentId id = ids[position];
+        if (cachedNextUse[id] == NOT_CACHED)
+            return false;
 
-        PositionHolder newPosHolder = IdPositionHolderMap[id];
-        currentPositionsQueue.push(newPosHolder);
+        // the content moves to the position of its next request
+        queue.erase(std::make_pair(cachedNextUse[id], id));
+        cachedNextUse[id] = nextUse[position];
+        queue.insert(std::make_pair(cachedNextUse[id], id));
 
         ++cyclesCount;
 
@@ -114,8 +125,9 @@ public:
         return true;
     }
 
-    void process(const std::string & id) {        
-        if (lookup.find(id) == lookup.end()) {
+    void process(const size_t & position) {
+        ContentId id = ids[position];
+        if (cachedNextUse[id] == NOT_CACHED) {
             ++missCount;
             
             size_t idSize = contentSizes[id];
@@ -123,12 +135,9 @@ public:
 
             if (idSize < cacheSize) {
 
-                // if current content will be requested only one time
+                // if current content will not be requested again
                 // then don't cache it
-                auto iter = itemPositions.find(id);
-                auto & positionList = iter->second;
-                if (positionList.size() == 2) {
-                    modifyPositionHolder(id);                    
+                if (nextUse[position] == neverUsed) {
                     ++cyclesCount;
                     return;
                 }
@@ -137,13 +146,9 @@ public:
                     freeUpSpace();
                 }
 
-                modifyPositionHolder(id);
-                
-                PositionHolder posHolder = IdPositionHolderMap[id];
-                currentPositionsQueue.push(posHolder);
-
-                lookup.insert(id);
-                currentCacheSize += contentSizes[id];
+                cachedNextUse[id] = nextUse[position];
+                queue.insert(std::make_pair(cachedNextUse[id], id));
+                currentCacheSize += idSize;
             }
 
         }
@@ -169,12 +174,12 @@ public:
         return currentCacheSize;
     }
 
-    ContentSizes getContentSizes() {
+    const ContentSizes & getContentSizes() {
         return contentSizes;
     }
 
     size_t size() {
-        return lookup.size();
+        return queue.size();
     }
 
     size_t getCyclesCount() {
@@ -187,15 +192,27 @@ public:
 
 private:
     void freeUpSpace() {
-        std::string itemToRemove;
-        const PositionHolder& maxPosition = currentPositionsQueue.top();
-        itemToRemove = maxPosition.it->first;
-        currentPositionsQueue.remove(maxPosition);
+        auto last = std::prev(queue.end());
+        ContentId itemToRemove = last->second;
+        queue.erase(last);
+        cachedNextUse[itemToRemove] = NOT_CACHED;
         currentCacheSize -= contentSizes[itemToRemove];
-        lookup.erase(itemToRemove);
+    }
+
+    // arrays of a big trace are written next to it
+    static std::string spill_directory(const std::string &fileName) {
+        size_t slash = fileName.find_last_of('/');
+        return (slash == std::string::npos) ? std::string(".") : fileName.substr(0, slash);
+    }
+
+    static size_t memory_limit() {
+        return static_cast<size_t>(sysconf(_SC_PHYS_PAGES)) *
+               static_cast<size_t>(sysconf(_SC_PAGE_SIZE)) / 2;
     }
 
 private:
+    static const uint64_t NOT_CACHED = UINT64_MAX;
+
     size_t cacheSize;
     size_t missCount;
     size_t cyclesCount;
@@ -205,38 +222,15 @@ private:
     size_t totalRequests;
     ContentSizes contentSizes;
 
-    ItemPositions itemPositions;
-    Lookup lookup;
-
-    struct PositionHolder {
-        size_t position;
-        ItemPositions::iterator it;
-
-        PositionHolder(){}
-
-        PositionHolder(size_t p, ItemPositions::iterator i) :
-                position(p),
-                it(i) {}
+    uint64_t neverUsed;
+    bool loaded_;
 
-        bool operator < (const PositionHolder& other) const {
-            return position < other.position;
-        }
-
-        friend std::ostream & operator << (std::ostream & out, const PositionHolder& posHolder) {
-            out << "position -> " << posHolder.position;
-            return out; 
-        }
-
-        bool operator == (const PositionHolder& other) const {
-            // return (this->position == other.position) && (this->it == other.it);
-            return (this->position == other.position) && (this->it->first == other.it->first);
-            
-        }
-    };
+    // content id and position of the next request for every request
+    MappedArray<ContentId> ids;
+    MappedArray<uint64_t> nextUse;
 
-    std::priority_queue<PositionHolder> positionsQueue;
-    custom_priority_queue<PositionHolder> currentPositionsQueue;
-    std::unordered_map<std::string, PositionHolder> IdPositionHolderMap;
+    std::vector<uint64_t> cachedNextUse;
+    EvictionQueue queue;
 };
 
 
@@ -252,35 +246,24 @@ int main(int argc, const char* argv[]) {
     int sec_start = now->tm_sec;
 
     OptCache cache(cacheSize, fileName);
+    if (!cache.loaded())
+        return -1;
 
     message = "After cache initialization.\0";
     now = print_current_data_and_time(message);
 
-    ContentSizes contentSizes = cache.getContentSizes();
-
-    size_t count = 0;
-    std::ifstream in(fileName);
-
-    while (true) {
-        size_t access_time;
-        std::string id;
-        size_t size;
+    if (cache.outOfCore())
+        std::cout << "Trace arrays are kept in files next to the trace" << std::endl;
 
-        in >> access_time;
-        in >> id;
-        in >> size;
-
-        if (in.eof()) {
-            break;
-        }
-        
-        bool value = cache.find(id);
+    size_t requestsCount = cache.requestsCount();
+    for (size_t position = 0; position < requestsCount; ++position) {
+        bool value = cache.find(position);
 
         if (value == false)
-            cache.process(id);
+            cache.process(position);
 
-        if (++count % 1000 == 0) {
-           std::cout << "Process " << count << "\n";
+        if ((position + 1) % 1000 == 0) {
+           std::cout << "Process " << position + 1 << "\n";
         }
     }
 
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstddef>
+#include <iostream>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+
+/*
+    Growable array of trivially copyable values in a memory mapping.
+
+    While the array fits into memory_limit bytes it lives in anonymous
+    memory. A bigger array is moved to an unlinked temporary file in
+    spill_dir, so the kernel can write it out instead of running out
+    of memory.
+*/
+template <typename T>
+class MappedArray {
+public:
+    MappedArray(const std::string &spill_dir, const size_t &memory_limit) :
+        spill_dir(spill_dir),
+        memory_limit(memory_limit),
+        data_(nullptr),
+        size_(0),
+        capacity_(0),
+        fd(-1) {}
+
+    ~MappedArray() {
+        if (data_ != nullptr)
+            munmap(data_, capacity_ * sizeof(T));
+        if (fd >= 0)
+            ::close(fd);
+    }
+
+    MappedArray(const MappedArray &) = delete;
+    MappedArray & operator = (const MappedArray &) = delete;
+
+    bool push_back(const T &value) {
+        if (size_ == capacity_ && !grow(std::max(2 * capacity_, size_t(INITIAL_CAPACITY))))
+            return false;
+        data_[size_++] = value;
+        return true;
+    }
+
+    // set the size of the array, new values are to be written by the caller
+    bool resize(const size_t &size) {
+        if (size > capacity_ && !grow(size))
+            return false;
+        size_ = size;
+        return true;
+    }
+
+    T & operator [] (const size_t &index) {
+        return data_[index];
+    }
+
+    const T & operator [] (const size_t &index) const {
+        return data_[index];
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool out_of_core() const {
+        return fd >= 0;
+    }
+
+    // hint for the kernel before a sequential or backward scan
+    void advise(const int &advice) {
+        if (data_ != nullptr)
+            madvise(data_, capacity_ * sizeof(T), advice);
+    }
+
+private:
+    bool grow(const size_t &capacity) {
+        size_t old_bytes = capacity_ * sizeof(T);
+        size_t bytes = capacity * sizeof(T);
+
+        if (fd < 0 && bytes > memory_limit)
+            return spill(capacity);
+
+        void *addr;
+        if (fd >= 0) {
+            if (ftruncate(fd, bytes) != 0) {
+                std::cerr << "[ERROR] Error while growing file in "
+                          << spill_dir << std::endl;
+                return false;
+            }
+            addr = mremap(data_, old_bytes, bytes, MREMAP_MAYMOVE);
+        } else if (data_ != nullptr) {
+            addr = mremap(data_, old_bytes, bytes, MREMAP_MAYMOVE);
+        } else {
+            addr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        }
+
+        if (addr == MAP_FAILED) {
+            std::cerr << "[ERROR] Error while allocating "
+                      << bytes << " bytes" << std::endl;
+            return false;
+        }
+
+        data_ = static_cast<T *>(addr);
+        capacity_ = capacity;
+        return true;
+    }
+
+    bool spill(const size_t &capacity) {
+        std::string pattern = spill_dir + "/opt_array_XXXXXX";
+        std::vector<char> filename(pattern.begin(), pattern.end());
+        filename.push_back('\0');
+
+        int file = mkstemp(filename.data());
+        if (file < 0) {
+            std::cerr << "[ERROR] Error while creating file in "
+                      << spill_dir << std::endl;
+            return false;
+        }
+        unlink(filename.data());
+
+        size_t bytes = capacity * sizeof(T);
+        void *addr = MAP_FAILED;
+        if (ftruncate(file, bytes) == 0)
+            addr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+
+        if (addr == MAP_FAILED) {
+            std::cerr << "[ERROR] Error while mapping file in "
+                      << spill_dir << std::endl;
+            ::close(file);
+            return false;
+        }
+
+        if (data_ != nullptr) {
+            memcpy(addr, data_, size_ * sizeof(T));
+            munmap(data_, capacity_ * sizeof(T));
+        }
+
+        data_ = static_cast<T *>(addr);
+        capacity_ = capacity;
+        fd = file;
+        return true;
+    }
+
+private:
+    static const size_t INITIAL_CAPACITY = 1 << 16;
+
+    std::string spill_dir;
+    size_t memory_limit;
+
+    T *data_;
+    size_t size_;
+    size_t capacity_;
+    int fd;
+};
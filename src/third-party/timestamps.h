@@ -7,7 +7,10 @@
 
 
 int comparisonWithEpsilon(const size_t &first, const size_t &second, const size_t &epsilon) {
-    if (abs(first - second) <= epsilon)
+    // first - second wraps around for first < second, and abs() of size_t
+    // is ambiguous once <cstdlib> overloads are visible
+    size_t difference = (first > second) ? first - second : second - first;
+    if (difference <= epsilon)
         return 0;
 
     if (first > second)
@@ -35,16 +38,28 @@ std::string ToString(T val)
 }
 
 
+std::string data_and_time_string(const struct tm &now) {
+    return ToString<int>(now.tm_year + 1900) + std::string("-") +
+           ToString<int>(now.tm_mon + 1) + std::string("-") +
+           ToString<int>(now.tm_mday ) + std::string(".") +
+           ToString<int>(now.tm_hour ) + std::string(":") +
+           ToString<int>(now.tm_min ) + std::string(":") +
+           ToString<int>(now.tm_sec );
+}
+
+
 struct tm * print_current_data_and_time(const std::string &message) {
     time_t t = time(0);
     struct tm * now = localtime(&t);
-    std::string str_time = ToString<int>(now->tm_year + 1900) + std::string("-") +
-                         ToString<int>(now->tm_mon + 1) + std::string("-") +
-                         ToString<int>(now->tm_mday ) + std::string(".") +
-                         ToString<int>(now->tm_hour ) + std::string(":") +
-                         ToString<int>(now->tm_min ) + std::string(":") +
-                         ToString<int>(now->tm_sec );
-
-    std::cout << std::setw(20) << str_time << " | " << message << std::endl;
+    std::cout << std::setw(20) << data_and_time_string(*now) << " | " << message << std::endl;
     return now;
 }
+
+
+/* the same line written to out, safe to call from several threads */
+void print_current_data_and_time(std::ostream &out, const std::string &message) {
+    time_t t = time(0);
+    struct tm now;
+    localtime_r(&t, &now);
+    out << std::setw(20) << data_and_time_string(now) << " | " << message << std::endl;
+}
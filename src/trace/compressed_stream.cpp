@@ -0,0 +1,251 @@
+#include "compressed_stream.h"
+
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include <climits>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+
+
+CompressedStream::CompressedStream() :
+    format(NONE),
+    chunks(CHUNKS_COUNT),
+    filled(CHUNKS_COUNT + 1),
+    free(CHUNKS_COUNT),
+    current(nullptr),
+    stop(false),
+    error(false),
+    gz(nullptr),
+    zstd(nullptr),
+    input(nullptr),
+    input_pos(0),
+    input_size(0),
+    frame_pending(false) {}
+
+CompressedStream::~CompressedStream() {
+    stop = true;
+    free.close();
+    filled.close();
+    if (worker.joinable())
+        worker.join();
+}
+
+CompressedStream::Format
+CompressedStream::detect_format(const char *data, const size_t &size) {
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(data);
+    if (size >= 2 && bytes[0] == 0x1f && bytes[1] == 0x8b)
+        return GZIP;
+    if (size >= 4 && bytes[0] == 0x28 && bytes[1] == 0xb5 &&
+        bytes[2] == 0x2f && bytes[3] == 0xfd)
+        return ZSTD;
+    return NONE;
+}
+
+bool CompressedStream::open(const std::string &filename, const Format &format) {
+#ifndef HAVE_ZSTD
+    if (format == ZSTD) {
+        std::cerr << "[ERROR] Built without zstd support, can not read "
+                  << filename << std::endl;
+        return false;
+    }
+#endif
+    if (format == NONE)
+        return false;
+
+    this->filename = filename;
+    this->format = format;
+    for (auto &chunk : chunks)
+        free.push(&chunk);
+
+    worker = std::thread(&CompressedStream::run, this);
+    return true;
+}
+
+const CompressedStream::Chunk * CompressedStream::next_chunk() {
+    if (current != nullptr) {
+        free.push(current);
+        current = nullptr;
+    }
+
+    if (!worker.joinable())
+        return nullptr;
+
+    Chunk *chunk = nullptr;
+    filled.pop(chunk);
+    if (chunk == nullptr) {
+        worker.join();
+        return nullptr;
+    }
+
+    current = chunk;
+    return chunk;
+}
+
+void CompressedStream::run() {
+    std::vector<char> carry;
+    bool eof = false;
+
+    if (!start_decoder()) {
+        error = true;
+        eof = true;
+    }
+
+    while (!eof && !stop) {
+        Chunk *chunk = nullptr;
+        if (!free.pop(chunk))
+            break;
+
+        std::vector<char> &data = chunk->data;
+        if (data.size() < std::max(CHUNK_SIZE, 2 * carry.size()))
+            data.resize(std::max(CHUNK_SIZE, 2 * carry.size()));
+
+        std::copy(carry.begin(), carry.end(), data.begin());
+        size_t used = carry.size();
+        carry.clear();
+
+        // fill the chunk and cut it after the last complete line
+        char *line_end = nullptr;
+        while (!eof) {
+            while (used < data.size()) {
+                size_t size = inflate(data.data() + used, data.size() - used);
+                if (size == 0) {
+                    eof = true;
+                    break;
+                }
+                used += size;
+            }
+
+            if (eof)
+                break;
+
+            line_end = static_cast<char *>(memrchr(data.data(), '\n', used));
+            if (line_end != nullptr)
+                break;
+
+            // line is longer than the chunk
+            data.resize(2 * data.size());
+        }
+
+        if (!eof) {
+            size_t cut = line_end + 1 - data.data();
+            carry.assign(data.begin() + cut, data.begin() + used);
+            used = cut;
+        }
+
+        chunk->size = used;
+        if (!filled.push(chunk))
+            break;
+    }
+
+    close_decoder();
+
+    // end of the stream
+    filled.push(nullptr);
+}
+
+bool CompressedStream::start_decoder() {
+    if (format == GZIP) {
+        gzFile file = gzopen(filename.c_str(), "rb");
+        if (file == nullptr) {
+            std::cerr << "[ERROR] Error while opening file " << filename << std::endl;
+            return false;
+        }
+        gzbuffer(file, 1 << 20);
+        gz = file;
+        return true;
+    }
+
+#ifdef HAVE_ZSTD
+    if (format == ZSTD) {
+        input = fopen(filename.c_str(), "rb");
+        if (input == nullptr) {
+            std::cerr << "[ERROR] Error while opening file " << filename << std::endl;
+            return false;
+        }
+        ZSTD_DStream *stream = ZSTD_createDStream();
+        ZSTD_initDStream(stream);
+        zstd = stream;
+        input_buffer.resize(ZSTD_DStreamInSize());
+        input_pos = input_size = 0;
+        frame_pending = false;
+        return true;
+    }
+#endif
+
+    return false;
+}
+
+size_t CompressedStream::inflate(char *out, const size_t &capacity) {
+    if (gz != nullptr) {
+        int size = gzread(static_cast<gzFile>(gz), out,
+                          static_cast<unsigned>(std::min(capacity, size_t(INT_MAX))));
+        if (size < 0) {
+            std::cerr << "[ERROR] Error while decompressing " << filename << std::endl;
+            error = true;
+            return 0;
+        }
+
+        // gzread() reports a truncated file as the end of the stream
+        int code = Z_OK;
+        if (size == 0)
+            gzerror(static_cast<gzFile>(gz), &code);
+        if (code == Z_BUF_ERROR) {
+            std::cerr << "[ERROR] Unexpected end of file " << filename << std::endl;
+            error = true;
+        }
+        return size;
+    }
+
+#ifdef HAVE_ZSTD
+    if (zstd != nullptr) {
+        ZSTD_outBuffer output = { out, capacity, 0 };
+        while (output.pos == 0) {
+            if (input_pos == input_size) {
+                input_size = fread(input_buffer.data(), 1, input_buffer.size(), input);
+                input_pos = 0;
+                if (input_size == 0) {
+                    if (frame_pending) {
+                        std::cerr << "[ERROR] Unexpected end of file " << filename << std::endl;
+                        error = true;
+                    }
+                    return 0;
+                }
+            }
+
+            ZSTD_inBuffer in = { input_buffer.data(), input_size, input_pos };
+            size_t result = ZSTD_decompressStream(static_cast<ZSTD_DStream *>(zstd), &output, &in);
+            if (ZSTD_isError(result)) {
+                std::cerr << "[ERROR] Error while decompressing " << filename
+                          << ": " << ZSTD_getErrorName(result) << std::endl;
+                error = true;
+                return 0;
+            }
+            input_pos = in.pos;
+            frame_pending = (result != 0);
+        }
+        return output.pos;
+    }
+#endif
+
+    return 0;
+}
+
+void CompressedStream::close_decoder() {
+    if (gz != nullptr)
+        gzclose(static_cast<gzFile>(gz));
+    gz = nullptr;
+
+#ifdef HAVE_ZSTD
+    if (zstd != nullptr)
+        ZSTD_freeDStream(static_cast<ZSTD_DStream *>(zstd));
+#endif
+    zstd = nullptr;
+
+    if (input != nullptr)
+        fclose(input);
+    input = nullptr;
+}
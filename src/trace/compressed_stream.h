@@ -0,0 +1,85 @@
+#pragma once
+
+#include "spsc_ring.h"
+
+#include <cstdio>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstddef>
+
+
+/*
+    Decompressed contents of a .gz or .zst trace.
+
+    A background thread inflates the file into a ring of buffers, so
+    decompression overlaps with the work of the consumer. Every chunk
+    ends at a line boundary, except the last chunk of the stream.
+*/
+class CompressedStream {
+public:
+    enum Format {
+        NONE,
+        GZIP,
+        ZSTD
+    };
+
+    struct Chunk {
+        std::vector<char> data;
+        size_t size;
+
+        Chunk() : size(0) {}
+    };
+
+    CompressedStream();
+    ~CompressedStream();
+
+    CompressedStream(const CompressedStream &) = delete;
+    CompressedStream & operator = (const CompressedStream &) = delete;
+
+    static Format detect_format(const char *data, const size_t &size);
+
+    // start decompression of the file in the background thread
+    bool open(const std::string &filename, const Format &format);
+
+    // next chunk of decompressed data or nullptr at the end of the stream;
+    // the previous chunk is given back to the decompression thread
+    const Chunk * next_chunk();
+
+    bool failed() const {
+        return error.load();
+    }
+
+private:
+    void run();
+    bool start_decoder();
+    // read up to capacity decompressed bytes, 0 at the end of the stream
+    size_t inflate(char *out, const size_t &capacity);
+    void close_decoder();
+
+private:
+    static const size_t CHUNKS_COUNT = 8;
+    static const size_t CHUNK_SIZE = 4 << 20;
+
+    std::string filename;
+    Format format;
+
+    std::vector<Chunk> chunks;
+    SpscRing<Chunk *> filled;
+    SpscRing<Chunk *> free;
+    Chunk *current;
+
+    std::thread worker;
+    std::atomic<bool> stop;
+    std::atomic<bool> error;
+
+    // decoder state, used by the background thread only
+    void *gz;
+    void *zstd;
+    FILE *input;
+    std::vector<char> input_buffer;
+    size_t input_pos, input_size;
+    // zstd frame is not complete yet
+    bool frame_pending;
+};
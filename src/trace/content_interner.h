@@ -0,0 +1,61 @@
+#pragma once
+
+#include "trace_request.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+
+/*
+    Map of content ids (cids) to dense integer identifiers.
+
+    Identifiers are assigned in order of the first appearance, so they
+    can index arrays of per-content data.
+*/
+class ContentInterner {
+public:
+    uint32_t intern(const std::string &cid) {
+        auto it = ids.find(cid);
+        if (it != ids.end())
+            return it->second;
+
+        uint32_t id = static_cast<uint32_t>(names.size());
+        ids.emplace(cid, id);
+        names.push_back(cid);
+        return id;
+    }
+
+    uint32_t intern(const StringRef &cid) {
+        key.assign(cid.data, cid.size);
+        return intern(key);
+    }
+
+    // false if the cid was never interned
+    bool find(const std::string &cid, uint32_t &id) const {
+        auto it = ids.find(cid);
+        if (it == ids.end())
+            return false;
+        id = it->second;
+        return true;
+    }
+
+    const std::string & name(const uint32_t &id) const {
+        return names[id];
+    }
+
+    size_t size() const {
+        return names.size();
+    }
+
+    void reserve(const size_t &count) {
+        ids.reserve(count);
+        names.reserve(count);
+    }
+
+private:
+    std::unordered_map<std::string, uint32_t> ids;
+    std::vector<std::string> names;
+    std::string key;
+};
@@ -0,0 +1,321 @@
+#include "trace_format.h"
+#include "trace_reader.h"
+#include "timestamps.h"
+
+#include <limits>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <algorithm>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+
+/*
+    Buffered writer of one column of the binary trace.
+    Columns are written with pwrite at their own offsets in the file.
+*/
+class ColumnWriter {
+public:
+    ColumnWriter(int fd, uint64_t offset) : fd(fd), offset(offset) {
+        buffer.reserve(BUFFER_SIZE);
+    }
+
+    // false if the buffer could not be written, the file is broken then
+    bool push(const uint32_t &value) {
+        buffer.push_back(value);
+        return buffer.size() < BUFFER_SIZE || flush();
+    }
+
+    bool flush() {
+        size_t length = buffer.size() * sizeof(uint32_t);
+        const char *data = reinterpret_cast<const char *>(buffer.data());
+        while (length > 0) {
+            ssize_t written = pwrite(fd, data, length, offset);
+            if (written <= 0) {
+                std::cerr << "[ERROR] Error while writing trace" << std::endl;
+                return false;
+            }
+            data += written;
+            length -= written;
+            offset += written;
+        }
+        buffer.clear();
+        return true;
+    }
+
+private:
+    static const size_t BUFFER_SIZE = 1 << 16;
+    int fd;
+    uint64_t offset;
+    std::vector<uint32_t> buffer;
+};
+
+
+// upper bound of the number of records, false if the trace can not be read
+bool count_lines(const std::string &filename, size_t &lines) {
+    MappedFile file;
+    if (!file.open(filename)) {
+        std::cerr << "[ERROR] Error while opening file " << filename << std::endl;
+        return false;
+    }
+
+    CompressedStream::Format format = CompressedStream::detect_format(file.data(), file.size());
+    if (format == CompressedStream::NONE) {
+        lines = std::count(file.data(), file.data() + file.size(), '\n') + 1;
+        return true;
+    }
+
+    file.close();
+    CompressedStream stream;
+    if (!stream.open(filename, format))
+        return false;
+
+    lines = 1;
+    const CompressedStream::Chunk *chunk;
+    while ((chunk = stream.next_chunk()) != nullptr)
+        lines += std::count(chunk->data.data(), chunk->data.data() + chunk->size, '\n');
+
+    if (stream.failed()) {
+        std::cerr << "[ERROR] Error while reading trace " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
+
+uint64_t align(const uint64_t &offset) {
+    return (offset + 63) & ~uint64_t(63);
+}
+
+bool write_objects(const std::string &filename,
+                   const std::vector<uint64_t> &sizes,
+                   const std::vector<std::string> &names)
+{
+    std::vector<uint64_t> name_offsets(1, 0);
+    for (auto &name : names)
+        name_offsets.push_back(name_offsets.back() + name.size());
+
+    TraceObjectsHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRACE_OBJECTS_MAGIC, 8);
+    header.objects_count = sizes.size();
+    header.names_size = name_offsets.back();
+    header.size_offset = align(sizeof(header));
+    header.name_offset_offset = align(header.size_offset + sizes.size() * sizeof(uint64_t));
+    header.names_offset = header.name_offset_offset + name_offsets.size() * sizeof(uint64_t);
+
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        std::cerr << "[ERROR] Error while opening file " << filename << std::endl;
+        return false;
+    }
+
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.seekp(header.size_offset);
+    out.write(reinterpret_cast<const char *>(sizes.data()), sizes.size() * sizeof(uint64_t));
+    out.seekp(header.name_offset_offset);
+    out.write(reinterpret_cast<const char *>(name_offsets.data()),
+              name_offsets.size() * sizeof(uint64_t));
+    for (auto &name : names)
+        out.write(name.data(), name.size());
+
+    return out.good();
+}
+
+int convert(const std::string &input, const std::string &output) {
+    size_t capacity = 0;
+    if (!count_lines(input, capacity))
+        return -1;
+
+    TraceReader reader;
+    if (!reader.open(input))
+        return -1;
+
+    if (reader.binary()) {
+        std::cerr << "[ERROR] " << input << " is already a binary trace" << std::endl;
+        return -1;
+    }
+
+    int fd = open(output.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "[ERROR] Error while opening file " << output << std::endl;
+        return -1;
+    }
+
+    TraceHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRACE_MAGIC, 8);
+    header.version = TRACE_VERSION;
+    header.flags = reader.has_pid() ? TRACE_HAS_PID : 0;
+    header.time_delta_offset = align(sizeof(header));
+    header.pid_offset = align(header.time_delta_offset + capacity * sizeof(uint32_t));
+    header.object_offset = reader.has_pid() ?
+                           align(header.pid_offset + capacity * sizeof(uint32_t)) :
+                           header.pid_offset;
+
+    ColumnWriter time_deltas(fd, header.time_delta_offset);
+    ColumnWriter pids(fd, header.pid_offset);
+    ColumnWriter objects(fd, header.object_offset);
+
+    std::unordered_map<std::string, uint32_t> object_ids;
+    std::vector<std::string> names;
+    std::vector<uint64_t> sizes;
+    size_t resized = 0;
+
+    TraceRequest request;
+    std::string cid;
+    size_t records = 0;
+    size_t previous_time = 0;
+    while (records < capacity && reader.next(request)) {
+        if (records == 0) {
+            header.base_time = request.time;
+            previous_time = request.time;
+        }
+
+        if (request.time < previous_time ||
+            request.time - previous_time > std::numeric_limits<uint32_t>::max())
+        {
+            std::cerr << "[ERROR] Trace is not sorted by time at line "
+                      << records + 1 << std::endl;
+            close(fd);
+            return -1;
+        }
+
+        cid.assign(request.cid.data, request.cid.size);
+        auto it = object_ids.find(cid);
+        if (it == object_ids.end()) {
+            it = object_ids.insert(std::make_pair(cid, (uint32_t)names.size())).first;
+            names.push_back(cid);
+            sizes.push_back(request.size);
+        } else if (sizes[it->second] != request.size) {
+            ++resized;
+        }
+
+        if (!time_deltas.push(request.time - previous_time) ||
+            (reader.has_pid() && !pids.push(request.pid)) ||
+            !objects.push(it->second))
+        {
+            close(fd);
+            return -1;
+        }
+
+        previous_time = request.time;
+        ++records;
+    }
+
+    if (reader.failed()) {
+        std::cerr << "[ERROR] Error while reading trace " << input << std::endl;
+        close(fd);
+        return -1;
+    }
+
+    header.records_count = records;
+    header.objects_count = names.size();
+
+    bool ok = time_deltas.flush() && pids.flush() && objects.flush() &&
+              pwrite(fd, &header, sizeof(header), 0) == sizeof(header);
+    close(fd);
+
+    if (!ok || !write_objects(trace_objects_filename(output), sizes, names))
+        return -1;
+
+    std::cout << "Records " << records << std::endl;
+    std::cout << "Objects " << names.size() << std::endl;
+    if (resized != 0)
+        std::cout << "Size changes (first size is kept) " << resized << std::endl;
+
+    return 0;
+}
+
+double seconds_since(const std::chrono::steady_clock::time_point &start) {
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+void print_throughput(const std::string &name, const size_t &bytes,
+                      const size_t &records, const double &seconds)
+{
+    double megabytes = bytes / (1024.0 * 1024.0);
+    std::cout << std::setw(10) << name << ": "
+              << records << " records, "
+              << megabytes << " MB in " << seconds << " secs, "
+              << (seconds > 0 ? megabytes / seconds : 0) << " MB/s" << std::endl;
+}
+
+/*
+    Compare throughput of stream extraction with the in-place parser
+*/
+int bench(const std::string &input) {
+    MappedFile file;
+    if (!file.open(input)) {
+        std::cerr << "[ERROR] Error while opening file " << input << std::endl;
+        return -1;
+    }
+
+    if (CompressedStream::detect_format(file.data(), file.size()) != CompressedStream::NONE ||
+        is_trace_magic(file.data(), file.size(), TRACE_MAGIC))
+    {
+        std::cerr << "[ERROR] Benchmark needs an uncompressed text trace" << std::endl;
+        return -1;
+    }
+
+    size_t records = 0;
+    size_t checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    {
+        TraceReader reader;
+        reader.open(input);
+        std::ifstream in(input);
+        size_t time, size;
+        long long pid;
+        std::string id;
+        while (true) {
+            if (reader.has_pid())
+                in >> time >> pid >> id >> size;
+            else
+                in >> time >> id >> size;
+            if (in.fail())
+                break;
+            checksum += time + size + id.size();
+            ++records;
+        }
+    }
+    print_throughput("iostream", file.size(), records, seconds_since(start));
+
+    records = 0;
+    start = std::chrono::steady_clock::now();
+    {
+        TraceReader reader;
+        reader.open(input);
+        TraceRequest request;
+        while (reader.next(request)) {
+            checksum -= request.time + request.size + request.cid.size;
+            ++records;
+        }
+    }
+    print_throughput("parser", file.size(), records, seconds_since(start));
+
+    return checksum == 0 ? 0 : -1;
+}
+
+int main(int argc, const char* argv[]) {
+    if (argc == 3 && std::string(argv[1]) == "--bench")
+        return bench(argv[2]);
+
+    if (argc != 3) {
+        std::cerr << "Usage: trace_convert <text trace> <binary trace>" << std::endl;
+        std::cerr << "       trace_convert --bench <text trace>" << std::endl;
+        return -1;
+    }
+
+    print_current_data_and_time("Start conversion.");
+    int result = convert(argv[1], argv[2]);
+    print_current_data_and_time("Conversion was finished.");
+    return result;
+}
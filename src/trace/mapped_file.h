@@ -0,0 +1,75 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+/*
+    Read-only memory mapping of a whole file.
+*/
+class MappedFile {
+public:
+    MappedFile() : data_(nullptr), size_(0) {}
+
+    ~MappedFile() {
+        close();
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile & operator = (const MappedFile &) = delete;
+
+    bool open(const std::string &filename) {
+        close();
+
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+            ::close(fd);
+            return false;
+        }
+
+        size_ = st.st_size;
+        if (size_ == 0) {
+            ::close(fd);
+            return true;
+        }
+
+        void *addr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (addr == MAP_FAILED) {
+            size_ = 0;
+            return false;
+        }
+
+        data_ = static_cast<const char *>(addr);
+        madvise(addr, size_, MADV_SEQUENTIAL);
+        return true;
+    }
+
+    void close() {
+        if (data_ != nullptr)
+            munmap(const_cast<char *>(data_), size_);
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+    const char * data() const {
+        return data_;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+private:
+    const char *data_;
+    size_t size_;
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "trace_request.h"
+
+#include <cstdint>
+#include <cstddef>
+
+
+/*
+    Spatial (SHARDS) sampling of a trace.
+
+    A content is sampled if the hash of its cid falls below a threshold,
+    so all requests of a sampled content are kept and the sample of
+    contents is uniform with the given rate.
+*/
+class SpatialSampler {
+public:
+    explicit SpatialSampler(const double &rate = 1.0) {
+        set_rate(rate);
+    }
+
+    void set_rate(const double &rate) {
+        rate_ = rate;
+        threshold = static_cast<uint64_t>(rate * MODULUS + 0.5);
+    }
+
+    double rate() const {
+        return rate_;
+    }
+
+    bool enabled() const {
+        return threshold < MODULUS;
+    }
+
+    bool sampled(const StringRef &cid) const {
+        return (hash(cid.data, cid.size) >> (64 - MODULUS_BITS)) < threshold;
+    }
+
+    // FNV-1a with the MurmurHash3 finalizer, the high bits are well mixed
+    static uint64_t hash(const char *data, const size_t &size) {
+        uint64_t h = 14695981039346656037ULL;
+        for (size_t i = 0; i < size; ++i) {
+            h ^= static_cast<unsigned char>(data[i]);
+            h *= 1099511628211ULL;
+        }
+
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+private:
+    static const unsigned MODULUS_BITS = 24;
+    static const uint64_t MODULUS = 1ULL << MODULUS_BITS;
+
+    double rate_;
+    uint64_t threshold;
+};
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <cstddef>
+#include <condition_variable>
+
+
+/*
+    Bounded lock-free queue for one producer thread and one consumer thread.
+    The capacity is rounded up to a power of two.
+
+    push() and pop() spin for a short while and then sleep until the other
+    side makes progress or the ring is closed, so a stalled side does not
+    burn a core. The mutex is taken only when a side sleeps.
+*/
+template <typename T>
+class SpscRing {
+public:
+    explicit SpscRing(size_t capacity = 16) : head(0), tail(0), sleepers(0), closed(false) {
+        size_t size = 1;
+        while (size < capacity)
+            size <<= 1;
+        items.resize(size);
+        mask = size - 1;
+    }
+
+    SpscRing(const SpscRing &) = delete;
+    SpscRing & operator = (const SpscRing &) = delete;
+
+    // producer side
+    bool try_push(const T &value) {
+        if (!put(value))
+            return false;
+        wake_sleeper();
+        return true;
+    }
+
+    // consumer side
+    bool try_pop(T &value) {
+        if (!take(value))
+            return false;
+        wake_sleeper();
+        return true;
+    }
+
+    // false if the ring was closed before the value was pushed
+    bool push(const T &value) {
+        return wait([this, &value] { return put(value); });
+    }
+
+    // false if the ring was closed before a value was popped
+    bool pop(T &value) {
+        return wait([this, &value] { return take(value); });
+    }
+
+    // push() and pop() waiting now or later return false
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        wakeup.notify_all();
+    }
+
+    size_t capacity() const {
+        return mask + 1;
+    }
+
+private:
+    static const size_t SPINS = 1024;
+
+    bool put(const T &value) {
+        size_t current_tail = tail.load(std::memory_order_relaxed);
+        if (current_tail - head.load(std::memory_order_acquire) > mask)
+            return false;
+
+        items[current_tail & mask] = value;
+        tail.store(current_tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool take(T &value) {
+        size_t current_head = head.load(std::memory_order_relaxed);
+        if (current_head == tail.load(std::memory_order_acquire))
+            return false;
+
+        value = items[current_head & mask];
+        head.store(current_head + 1, std::memory_order_release);
+        return true;
+    }
+
+    template <typename Attempt>
+    bool wait(Attempt attempt) {
+        bool done = false;
+        for (size_t spin = 0; spin < SPINS && !done; ++spin) {
+            done = attempt();
+            if (!done && closed.load(std::memory_order_relaxed))
+                return false;
+        }
+
+        if (!done) {
+            std::unique_lock<std::mutex> lock(mutex);
+            sleepers.fetch_add(1);
+            // pairs with the fence in wake_sleeper(), either the other side
+            // sees the sleeper or the attempt sees its progress
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            wakeup.wait(lock, [this, &attempt, &done] {
+                done = attempt();
+                return done || closed.load(std::memory_order_relaxed);
+            });
+            sleepers.fetch_sub(1);
+        }
+
+        // the other side may sleep on the progress of this one
+        if (done)
+            wake_sleeper();
+        return done;
+    }
+
+    void wake_sleeper() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleepers.load(std::memory_order_relaxed) == 0)
+            return;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        wakeup.notify_all();
+    }
+
+private:
+    std::vector<T> items;
+    size_t mask;
+
+    // head is written by the consumer only, tail by the producer only
+    alignas(64) std::atomic<size_t> head;
+    alignas(64) std::atomic<size_t> tail;
+
+    alignas(64) std::atomic<size_t> sleepers;
+    std::atomic<bool> closed;
+    std::mutex mutex;
+    std::condition_variable wakeup;
+};
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "trace_request.h"
+
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+
+
+/*
+    Parser of text trace lines "time [pid] cid size".
+
+    It scans a buffer in place: integers are parsed without copying
+    and cids are returned as references into the buffer, so no memory
+    is allocated per line.
+*/
+class TextTraceParser {
+public:
+    enum Status {
+        RECORD,     // request was parsed
+        INCOMPLETE, // buffer ends inside a line, more data is needed
+        END,        // no more lines in the buffer
+        MALFORMED   // line can not be parsed
+    };
+
+    TextTraceParser() : has_pid_(false), lines(0) {}
+
+    // detect the pid column by the number of fields in the first line
+    void detect_columns(const char *begin, const char *end) {
+        const char *eol = static_cast<const char *>(memchr(begin, '\n', end - begin));
+        if (eol == nullptr)
+            eol = end;
+
+        size_t columns = 0;
+        StringRef token;
+        while (parse_token(begin, eol, token))
+            ++columns;
+
+        has_pid_ = (columns >= 4);
+    }
+
+    // parse the line at cursor and move cursor to the next line;
+    // 'last' means that the buffer holds the end of the trace
+    Status parse(const char *&cursor, const char *end, const bool &last,
+                 TraceRequest &request)
+    {
+        const char *p = cursor;
+        while (p < end && is_space(*p))
+            ++p;
+
+        if (p == end) {
+            cursor = p;
+            return last ? END : INCOMPLETE;
+        }
+
+        const char *eol = static_cast<const char *>(memchr(p, '\n', end - p));
+        if (eol == nullptr) {
+            if (!last)
+                return INCOMPLETE;
+            eol = end;
+        }
+
+        ++lines;
+        uint64_t time = 0, pid = 0, size = 0;
+        if (!parse_uint(p, eol, time) ||
+            (has_pid_ && !parse_uint(p, eol, pid)) ||
+            !parse_token(p, eol, request.cid) ||
+            !parse_uint(p, eol, size))
+        {
+            return MALFORMED;
+        }
+
+        request.time = time;
+        request.pid = pid;
+        request.size = size;
+        cursor = (eol < end) ? eol + 1 : eol;
+        return RECORD;
+    }
+
+    bool has_pid() const {
+        return has_pid_;
+    }
+
+    // number of parsed lines, for error messages
+    size_t line() const {
+        return lines;
+    }
+
+private:
+    static bool is_space(const char &c) {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+
+    static bool is_blank(const char &c) {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    static bool parse_uint(const char *&p, const char *end, uint64_t &value) {
+        while (p < end && is_blank(*p))
+            ++p;
+
+        const char *start = p;
+        uint64_t result = 0;
+        while (p < end && static_cast<unsigned>(*p - '0') < 10) {
+            result = result * 10 + static_cast<unsigned>(*p - '0');
+            ++p;
+        }
+
+        value = result;
+        return p != start && (p == end || is_blank(*p));
+    }
+
+    static bool parse_token(const char *&p, const char *end, StringRef &token) {
+        while (p < end && is_blank(*p))
+            ++p;
+
+        const char *start = p;
+        while (p < end && !is_blank(*p))
+            ++p;
+
+        token = StringRef(start, p - start);
+        return p != start;
+    }
+
+private:
+    bool has_pid_;
+    size_t lines;
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+/*
+    Binary columnar trace format.
+
+    <trace>          header + fixed-width columns:
+                        uint32 time_delta[records_count]  (delta to previous request)
+                        uint32 pid[records_count]         (only if TRACE_HAS_PID)
+                        uint32 object[records_count]      (dense object id)
+    <trace>.objects  sidecar table of objects:
+                        uint64 size[objects_count]
+                        uint64 name_offset[objects_count + 1]
+                        char   names[names_size]          (cid strings, not terminated)
+
+    All values are stored in host byte order. Every column starts at
+    the offset written in the header, so readers can mmap the file
+    and address the columns directly.
+*/
+
+#define TRACE_MAGIC "CTRACE01"
+#define TRACE_OBJECTS_MAGIC "COBJS001"
+#define TRACE_OBJECTS_SUFFIX ".objects"
+#define TRACE_VERSION 1
+
+#define TRACE_HAS_PID 0x1
+
+
+struct TraceHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t records_count;
+    uint64_t objects_count;
+    uint64_t base_time;
+    uint64_t time_delta_offset;
+    uint64_t pid_offset;
+    uint64_t object_offset;
+};
+
+struct TraceObjectsHeader {
+    char magic[8];
+    uint64_t objects_count;
+    uint64_t names_size;
+    uint64_t size_offset;
+    uint64_t name_offset_offset;
+    uint64_t names_offset;
+};
+
+inline bool is_trace_magic(const char *data, size_t length, const char *magic) {
+    return length >= 8 && memcmp(data, magic, 8) == 0;
+}
+
+inline std::string trace_objects_filename(const std::string &filename) {
+    return filename + TRACE_OBJECTS_SUFFIX;
+}
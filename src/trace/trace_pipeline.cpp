@@ -0,0 +1,155 @@
+#include "trace_pipeline.h"
+
+#include <chrono>
+#include <cstring>
+
+
+TracePipeline::TracePipeline() :
+    interner(nullptr),
+    records_count_(0),
+    copy_cids(false),
+    has_pending(false),
+    batches(BATCHES_COUNT),
+    filled(BATCHES_COUNT + 1),
+    free(BATCHES_COUNT),
+    current(nullptr),
+    stop(false),
+    read_seconds(0.0) {}
+
+TracePipeline::~TracePipeline() {
+    stop = true;
+    free.close();
+    filled.close();
+    if (worker.joinable())
+        worker.join();
+}
+
+bool TracePipeline::open(const std::string &filename, ContentInterner *interner) {
+    if (!reader_.open(filename))
+        return false;
+
+    this->interner = interner;
+    if (reader_.binary() && sampler.enabled()) {
+        object_sampled_.resize(reader_.objects_count());
+        for (size_t object = 0; object < object_sampled_.size(); ++object) {
+            std::string name = reader_.object_name(object);
+            object_sampled_[object] = sampler.sampled(StringRef(name.data(), name.size()));
+        }
+    }
+
+    if (interner != nullptr && reader_.binary()) {
+        interner->reserve(interner->size() + reader_.objects_count());
+        object_ids.resize(reader_.objects_count());
+        for (size_t object = 0; object < object_ids.size(); ++object) {
+            if (object_sampled(object))
+                object_ids[object] = interner->intern(reader_.object_name(object));
+        }
+    }
+
+    copy_cids = !reader_.stable_cids();
+    for (auto &batch : batches) {
+        batch.requests.resize(BATCH_SIZE);
+        if (copy_cids)
+            batch.arena.resize(ARENA_SIZE);
+        free.push(&batch);
+    }
+
+    worker = std::thread(&TracePipeline::run, this);
+    return true;
+}
+
+const RequestBatch * TracePipeline::next_batch() {
+    if (current != nullptr) {
+        free.push(current);
+        current = nullptr;
+    }
+
+    if (!worker.joinable())
+        return nullptr;
+
+    RequestBatch *batch = nullptr;
+    filled.pop(batch);
+    if (batch == nullptr) {
+        worker.join();
+        return nullptr;
+    }
+
+    current = batch;
+    return batch;
+}
+
+void TracePipeline::run() {
+    typedef std::chrono::steady_clock Clock;
+    Clock::duration busy = Clock::duration::zero();
+
+    while (!stop) {
+        RequestBatch *batch = nullptr;
+        if (!free.pop(batch))
+            break;
+
+        Clock::time_point start = Clock::now();
+        fill(*batch);
+        busy += Clock::now() - start;
+
+        // the empty batch is not given back, the consumer is the only
+        // producer of the free ring
+        if (batch->count == 0)
+            break;
+
+        if (!filled.push(batch))
+            break;
+    }
+
+    read_seconds = std::chrono::duration<double>(busy).count();
+
+    // end of the trace
+    filled.push(nullptr);
+}
+
+void TracePipeline::fill(RequestBatch &batch) {
+    batch.count = 0;
+    size_t arena_used = 0;
+
+    while (batch.count < batch.requests.size()) {
+        TraceRequest &request = batch.requests[batch.count];
+        if (has_pending) {
+            request = pending;
+            has_pending = false;
+        } else {
+            if (!reader_.next(request))
+                break;
+
+            ++records_count_;
+            if (sampler.enabled()) {
+                bool sampled = reader_.binary() ? object_sampled_[request.id]
+                                                : sampler.sampled(request.cid);
+                if (!sampled)
+                    continue;
+            }
+
+            if (interner != nullptr) {
+                request.id = reader_.binary() ? object_ids[request.id]
+                                              : interner->intern(request.cid);
+            }
+        }
+
+        if (copy_cids) {
+            // arena is not reallocated while cids of the batch point into it
+            if (arena_used + request.cid.size > batch.arena.size()) {
+                if (batch.count != 0) {
+                    pending = request;
+                    has_pending = true;
+                    break;
+                }
+                batch.arena.resize(request.cid.size);
+            }
+
+            char *cid = batch.arena.data() + arena_used;
+            memcpy(cid, request.cid.data, request.cid.size);
+            request.cid.data = cid;
+            arena_used += request.cid.size;
+        }
+
+        ++batch.count;
+    }
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "trace_reader.h"
+#include "spsc_ring.h"
+#include "content_interner.h"
+#include "spatial_sampler.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+
+/*
+    Batch of consecutive trace requests.
+
+    Cids of plain text and binary traces refer to the mapped trace file.
+    Cids of compressed traces are copied into the batch arena, because
+    the decompressed chunk is reused by the stream.
+*/
+struct RequestBatch {
+    std::vector<TraceRequest> requests;
+    std::vector<char> arena;
+    size_t count;
+
+    RequestBatch() : count(0) {}
+
+    const TraceRequest * begin() const {
+        return requests.data();
+    }
+
+    const TraceRequest * end() const {
+        return requests.data() + count;
+    }
+};
+
+
+/*
+    Trace reader running on its own thread.
+
+    The producer thread reads and parses requests into batches and hands
+    them to the consumer through a bounded SPSC ring, so reading and
+    parsing overlap with the cache simulation.
+
+    With an interner the producer also assigns dense content ids to
+    requests. The interner is used by the producer thread only until
+    the end of the trace. With a sampling rate below one only requests
+    of spatially sampled contents are passed to the consumer.
+*/
+class TracePipeline {
+public:
+    TracePipeline();
+    ~TracePipeline();
+
+    TracePipeline(const TracePipeline &) = delete;
+    TracePipeline & operator = (const TracePipeline &) = delete;
+
+    // sampling rate of contents, must be set before the trace is opened
+    void set_sampling_rate(const double &rate) {
+        sampler.set_rate(rate);
+    }
+
+    // open the trace and start the producer thread
+    bool open(const std::string &filename, ContentInterner *interner = nullptr);
+
+    // next batch of requests or nullptr at the end of the trace;
+    // the previous batch is given back to the producer thread
+    const RequestBatch * next_batch();
+
+    // reader of the trace, its objects table can be used by the consumer
+    const TraceReader & reader() const {
+        return reader_;
+    }
+
+    // content id of the object of a binary trace, when opened with an interner
+    uint32_t object_id(const uint32_t &object) const {
+        return object_ids[object];
+    }
+
+    bool object_sampled(const uint32_t &object) const {
+        return !sampler.enabled() || object_sampled_[object];
+    }
+
+    // trace could not be read to its end, valid after the last batch
+    bool failed() const {
+        return reader_.failed();
+    }
+
+    // number of requests read from the trace, sampled out requests included;
+    // final after the end of the trace
+    size_t records_count() const {
+        return records_count_;
+    }
+
+    // seconds spent by the producer thread, waiting for free batches excluded
+    double read_time() const {
+        return read_seconds;
+    }
+
+private:
+    void run();
+    void fill(RequestBatch &batch);
+
+private:
+    static const size_t BATCHES_COUNT = 8;
+    static const size_t BATCH_SIZE = 4096;
+    static const size_t ARENA_SIZE = 256 << 10;
+
+    TraceReader reader_;
+    ContentInterner *interner;
+    std::vector<uint32_t> object_ids;
+    SpatialSampler sampler;
+    std::vector<bool> object_sampled_;
+    size_t records_count_;
+    bool copy_cids;
+    bool has_pending;
+    TraceRequest pending;
+
+    std::vector<RequestBatch> batches;
+    SpscRing<RequestBatch *> filled;
+    SpscRing<RequestBatch *> free;
+    RequestBatch *current;
+
+    std::thread worker;
+    std::atomic<bool> stop;
+    double read_seconds;
+};
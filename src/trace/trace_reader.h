@@ -0,0 +1,238 @@
+#pragma once
+
+#include "trace_format.h"
+#include "trace_request.h"
+#include "text_parser.h"
+#include "mapped_file.h"
+#include "compressed_stream.h"
+
+#include <string>
+#include <iostream>
+#include <cstdint>
+
+
+/*
+    Sequential reader of a request trace.
+
+    A binary trace (see trace_format.h) is mapped into memory together
+    with its objects sidecar and read without copying. Any other file is
+    mapped and parsed in place as a text trace with lines
+    "time [pid] cid size"; the presence of the pid column is detected
+    from the first line. Text traces compressed with gzip or zstd are
+    inflated by a background thread and parsed chunk by chunk.
+*/
+class TraceReader {
+public:
+    TraceReader() :
+        binary_(false), has_pid_(false), failed_(false), compressed(false),
+        cursor(nullptr), text_end(nullptr),
+        position(0), current_time(0),
+        header(nullptr), objects_header(nullptr),
+        time_deltas(nullptr), pids(nullptr), objects(nullptr),
+        sizes(nullptr), name_offsets(nullptr), names(nullptr) {}
+
+    TraceReader(const TraceReader &) = delete;
+    TraceReader & operator = (const TraceReader &) = delete;
+
+    bool open(const std::string &filename) {
+        if (!trace_file.open(filename)) {
+            std::cerr << "[ERROR] Error while opening file "
+                      << filename << std::endl;
+            return false;
+        }
+
+        if (is_trace_magic(trace_file.data(), trace_file.size(), TRACE_MAGIC))
+            return open_binary(filename);
+
+        CompressedStream::Format format =
+            CompressedStream::detect_format(trace_file.data(), trace_file.size());
+        if (format != CompressedStream::NONE)
+            return open_compressed(filename, format);
+
+        return open_text();
+    }
+
+    bool next(TraceRequest &request) {
+        if (binary_) {
+            if (position >= header->records_count)
+                return false;
+
+            uint32_t object = objects[position];
+            current_time += time_deltas[position];
+            request.time = current_time;
+            request.pid = has_pid_ ? pids[position] : 0;
+            request.cid = StringRef(names + name_offsets[object],
+                                    name_offsets[object + 1] - name_offsets[object]);
+            request.size = sizes[object];
+            request.id = object;
+            ++position;
+            return true;
+        }
+
+        if (failed_)
+            return false;
+
+        while (true) {
+            // every chunk of a compressed trace ends at a line boundary
+            TextTraceParser::Status status = parser.parse(cursor, text_end, true, request);
+            if (status == TextTraceParser::RECORD)
+                return true;
+
+            if (status == TextTraceParser::MALFORMED) {
+                std::cerr << "[ERROR] Malformed trace line "
+                          << parser.line() << std::endl;
+                failed_ = true;
+                return false;
+            }
+
+            if (!compressed || !next_chunk())
+                return false;
+        }
+    }
+
+    bool binary() const {
+        return binary_;
+    }
+
+    bool has_pid() const {
+        return has_pid_;
+    }
+
+    // next() stopped on a malformed line or a broken compressed stream
+    // rather than at the end of the trace
+    bool failed() const {
+        return failed_;
+    }
+
+    // cids of plain text and binary traces point into the mapped file
+    // and stay valid while the reader is open
+    bool stable_cids() const {
+        return !compressed;
+    }
+
+    // objects table, available for binary traces only
+
+    size_t objects_count() const {
+        return binary_ ? objects_header->objects_count : 0;
+    }
+
+    size_t object_size(const uint32_t &object) const {
+        return sizes[object];
+    }
+
+    std::string object_name(const uint32_t &object) const {
+        return std::string(names + name_offsets[object],
+                           name_offsets[object + 1] - name_offsets[object]);
+    }
+
+private:
+    bool open_binary(const std::string &filename) {
+        header = reinterpret_cast<const TraceHeader *>(trace_file.data());
+        if (trace_file.size() < sizeof(TraceHeader) ||
+            header->version != TRACE_VERSION ||
+            header->object_offset + header->records_count * sizeof(uint32_t) > trace_file.size())
+        {
+            std::cerr << "[ERROR] Broken binary trace " << filename << std::endl;
+            return false;
+        }
+
+        std::string objects_filename = trace_objects_filename(filename);
+        if (!objects_file.open(objects_filename) ||
+            !is_trace_magic(objects_file.data(), objects_file.size(), TRACE_OBJECTS_MAGIC))
+        {
+            std::cerr << "[ERROR] Error while opening objects table "
+                      << objects_filename << std::endl;
+            return false;
+        }
+
+        objects_header = reinterpret_cast<const TraceObjectsHeader *>(objects_file.data());
+        if (objects_header->objects_count != header->objects_count ||
+            objects_header->names_offset + objects_header->names_size > objects_file.size())
+        {
+            std::cerr << "[ERROR] Objects table " << objects_filename
+                      << " does not match trace " << filename << std::endl;
+            return false;
+        }
+
+        const char *base = trace_file.data();
+        time_deltas = reinterpret_cast<const uint32_t *>(base + header->time_delta_offset);
+        pids = reinterpret_cast<const uint32_t *>(base + header->pid_offset);
+        objects = reinterpret_cast<const uint32_t *>(base + header->object_offset);
+
+        base = objects_file.data();
+        sizes = reinterpret_cast<const uint64_t *>(base + objects_header->size_offset);
+        name_offsets = reinterpret_cast<const uint64_t *>(base + objects_header->name_offset_offset);
+        names = base + objects_header->names_offset;
+
+        binary_ = true;
+        has_pid_ = (header->flags & TRACE_HAS_PID) != 0;
+        position = 0;
+        current_time = header->base_time;
+        return true;
+    }
+
+    bool open_text() {
+        cursor = trace_file.data();
+        text_end = cursor + trace_file.size();
+        if (cursor != text_end)
+            parser.detect_columns(cursor, text_end);
+        has_pid_ = parser.has_pid();
+        return true;
+    }
+
+    bool open_compressed(const std::string &filename,
+                         const CompressedStream::Format &format)
+    {
+        trace_file.close();
+        if (!stream.open(filename, format))
+            return false;
+
+        compressed = true;
+        if (!next_chunk())
+            return !failed_;
+
+        parser.detect_columns(cursor, text_end);
+        has_pid_ = parser.has_pid();
+        return true;
+    }
+
+    bool next_chunk() {
+        const CompressedStream::Chunk *chunk = stream.next_chunk();
+        if (chunk == nullptr) {
+            cursor = text_end = nullptr;
+            failed_ = stream.failed();
+            return false;
+        }
+
+        cursor = chunk->data.data();
+        text_end = cursor + chunk->size;
+        return true;
+    }
+
+private:
+    bool binary_;
+    bool has_pid_;
+    bool failed_;
+
+    MappedFile trace_file;
+
+    // text trace
+    bool compressed;
+    CompressedStream stream;
+    TextTraceParser parser;
+    const char *cursor;
+    const char *text_end;
+
+    // binary trace
+    MappedFile objects_file;
+    size_t position;
+    size_t current_time;
+    const TraceHeader *header;
+    const TraceObjectsHeader *objects_header;
+    const uint32_t *time_deltas;
+    const uint32_t *pids;
+    const uint32_t *objects;
+    const uint64_t *sizes;
+    const uint64_t *name_offsets;
+    const char *names;
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+
+
+/*
+    Non-owning reference to a string inside a trace buffer.
+*/
+struct StringRef {
+    const char *data;
+    size_t size;
+
+    StringRef() : data(nullptr), size(0) {}
+    StringRef(const char *data, const size_t &size) : data(data), size(size) {}
+
+    std::string str() const {
+        return std::string(data, size);
+    }
+
+    bool operator == (const StringRef &other) const {
+        return size == other.size && memcmp(data, other.data, size) == 0;
+    }
+};
+
+
+/*
+    One request of a trace. cid refers to the reader's buffer
+    and stays valid until the next request is read. id is the dense
+    identifier of the content: the object index in a binary trace
+    or the id assigned by the TracePipeline interner.
+*/
+struct TraceRequest {
+    size_t time;
+    long long pid;
+    StringRef cid;
+    size_t size;
+    uint32_t id;
+
+    TraceRequest() : time(0), pid(0), size(0), id(0) {}
+};